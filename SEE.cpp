@@ -8,11 +8,13 @@ inline uint64_t getAttackers(const Board& brd, int square) noexcept {
     uint64_t whitePawns = brd.WPawn;
     uint64_t blackPawns = brd.BPawn;
     
-    attackers |= ((1ULL << square) >> 7) & ~File1 & whitePawns;
-    attackers |= ((1ULL << square) >> 9) & ~File8 & whitePawns;
+    // File1 is the h-file and File8 the a-file; each mask drops the pawn a
+    // shift would wrap onto the other edge.
+    attackers |= ((1ULL << square) >> 7) & ~File8 & whitePawns;
+    attackers |= ((1ULL << square) >> 9) & ~File1 & whitePawns;
     
-    attackers |= ((1ULL << square) << 7) & ~File8 & blackPawns;
-    attackers |= ((1ULL << square) << 9) & ~File1 & blackPawns;
+    attackers |= ((1ULL << square) << 7) & ~File1 & blackPawns;
+    attackers |= ((1ULL << square) << 9) & ~File8 & blackPawns;
     
     attackers |= knightMasks[square] & (brd.WKnight | brd.BKnight);
     
@@ -29,165 +31,123 @@ inline uint64_t getAttackers(const Board& brd, int square) noexcept {
     return attackers;
 }
 
-inline int getLeastValuableAttacker(const Board& brd, int square, bool isWhite, uint64_t& attackers, int& pieceType) noexcept {
-    uint64_t sideAttackers = attackers & (isWhite ? brd.White : brd.Black);
-    if (!sideAttackers) return -1;
-    
-    uint64_t pawnAttackers = sideAttackers & (isWhite ? brd.WPawn : brd.BPawn);
-    if (pawnAttackers) {
-        pieceType = 0;
-        int attackerSquare = __builtin_ctzll(pawnAttackers);
-        attackers &= ~(1ULL << attackerSquare);
-        return attackerSquare;
-    }
-    
-    uint64_t knightAttackers = sideAttackers & (isWhite ? brd.WKnight : brd.BKnight);
-    if (knightAttackers) {
-        pieceType = 1;
-        int attackerSquare = __builtin_ctzll(knightAttackers);
-        attackers &= ~(1ULL << attackerSquare);
-        return attackerSquare;
-    }
-    
-    uint64_t bishopAttackers = sideAttackers & (isWhite ? brd.WBishop : brd.BBishop);
-    if (bishopAttackers) {
-        pieceType = 2;
-        int attackerSquare = __builtin_ctzll(bishopAttackers);
-        attackers &= ~(1ULL << attackerSquare);
-        return attackerSquare;
-    }
-    
-    uint64_t rookAttackers = sideAttackers & (isWhite ? brd.WRook : brd.BRook);
-    if (rookAttackers) {
-        pieceType = 3;
-        int attackerSquare = __builtin_ctzll(rookAttackers);
-        attackers &= ~(1ULL << attackerSquare);
-        return attackerSquare;
-    }
-    
-    uint64_t queenAttackers = sideAttackers & (isWhite ? brd.WQueen : brd.BQueen);
-    if (queenAttackers) {
-        pieceType = 4;
-        int attackerSquare = __builtin_ctzll(queenAttackers);
-        attackers &= ~(1ULL << attackerSquare);
-        return attackerSquare;
-    }
-    
-    uint64_t kingAttackers = sideAttackers & (isWhite ? brd.WKing : brd.BKing);
-    if (kingAttackers) {
-        pieceType = 5;
-        int attackerSquare = __builtin_ctzll(kingAttackers);
-        attackers &= ~(1ULL << attackerSquare);
-        return attackerSquare;
+constexpr int seePieceValues[6] = {
+    100, 320, 330, 500, 900, 20000
+};
+
+// Pieces of `side` pinned to their own king, and the enemy sliders pinning
+// them. A pinned piece may only join the exchange once its pinner is gone.
+inline uint64_t pinnedTo(const Board& brd, bool side, uint64_t& pinners) noexcept {
+    const int king = __builtin_ctzll(side ? brd.WKing : brd.BKing);
+    const uint64_t own = side ? brd.White : brd.Black;
+    const uint64_t snipers =
+        (getRmagic(king, 0) & (side ? brd.BRook | brd.BQueen : brd.WRook | brd.WQueen)) |
+        (getBmagic(king, 0) & (side ? brd.BBishop | brd.BQueen : brd.WBishop | brd.WQueen));
+    uint64_t pinned = 0;
+    pinners = 0;
+    uint64_t loop = snipers;
+    while (loop) {
+        const int sniper = __builtin_ctzll(loop);
+        loop &= loop - 1;
+        const uint64_t between = kingPath[64 * king + sniper] & ~(1ULL << sniper) & brd.Occ;
+        if (between && !(between & (between - 1)) && (between & own)) {
+            pinned |= between;
+            pinners |= 1ULL << sniper;
+        }
     }
-    
-    return -1;
+    return pinned;
 }
 
+// Whether the exchange `move` starts on its target square nets at least
+// `threshold`. It keeps only the running balance and returns as soon as the
+// side to recapture can no longer change the answer.
+bool seeGE(const Board& brd, EncodedMove move, int threshold) noexcept {
+    const MoveKind kind = moveKind(move);
+    if (kind == MoveKind::CastleLeft || kind == MoveKind::CastleRight) {
+        return threshold <= 0;
+    }
+    const int from = moveFrom(move);
+    const int to = moveTo(move);
+    uint64_t occ = brd.Occ ^ (1ULL << from);
 
-inline void updateAttackers(uint64_t& attackers, const Board& brd, uint64_t& occ, int fromSquare, int toSquare, int piece) noexcept {
-    // fromSquare has already been cleared from occ before this call;
-    // reveal any x-ray pieces that were hiding behind fromSquare by
-    // re-scanning rook/bishop rays from toSquare through the updated occ.
-    (void)toSquare; // rays are cast from toSquare but reveal pieces behind fromSquare
-
-    if (piece == 3 || piece == 4 || piece == 5 || piece == 0) {
-        uint64_t rookAttacks = getRmagic(toSquare, occ);
-        attackers |= rookAttacks & (brd.WRook | brd.BRook | 
-                                   brd.WQueen | brd.BQueen) & occ;
+    // What the move wins, and what then stands on `to` for the other side
+    // to take.
+    int gain = 0;
+    int onSquare = brd.pieceOn(from);
+    if (kind == MoveKind::EnPassant) {
+        gain = seePieceValues[0];
+        occ ^= 1ULL << (to ^ 8);
+    } else if (brd.pieceOn(to) != NO_PIECE) {
+        gain = seePieceValues[brd.pieceOn(to)];
     }
-    
-    if (piece == 2 || piece == 4 || piece == 5 || piece == 0) {
-        uint64_t bishopAttacks = getBmagic(toSquare, occ);
-        attackers |= bishopAttacks & (brd.WBishop | brd.BBishop | 
-                                     brd.WQueen | brd.BQueen) & occ;
+    if (isPromotion(move)) {
+        onSquare = (int)promotionPieces[movePromotion(move)];
+        gain += seePieceValues[onSquare] - seePieceValues[0];
     }
-}
 
-inline int getMovingPieceType(const Board& brd, int sq) noexcept {
-    uint64_t fromBit = 1ULL << sq;
-    
-    if (brd.White & fromBit) {
-        if (brd.WPawn & fromBit) return 0;
-        if (brd.WKnight & fromBit) return 1;
-        if (brd.WBishop & fromBit) return 2;
-        if (brd.WRook & fromBit) return 3;
-        if (brd.WQueen & fromBit) return 4;
-        if (brd.WKing & fromBit) return 5;
+    int swap = gain - threshold;
+    if (swap < 0) {
+        return false;
     }
-    else if (brd.Black & fromBit) {
-        if (brd.BPawn & fromBit) return 0;
-        if (brd.BKnight & fromBit) return 1;
-        if (brd.BBishop & fromBit) return 2;
-        if (brd.BRook & fromBit) return 3;
-        if (brd.BQueen & fromBit) return 4;
-        if (brd.BKing & fromBit) return 5;
+    swap = seePieceValues[onSquare] - swap;
+    if (swap <= 0) {
+        return true;
     }
-    
-    return -1;
-}
 
-constexpr int seePieceValues[6] = {
-    100, 320, 330, 500, 900, 20000
-};
+    occ |= 1ULL << to;
+    const uint64_t diagonal = brd.WBishop | brd.BBishop | brd.WQueen | brd.BQueen;
+    const uint64_t straight = brd.WRook | brd.BRook | brd.WQueen | brd.BQueen;
+    uint64_t attackers = getAttackers(brd, to) & occ;
+    // getAttackers used the board's occupancy; the moving piece may have
+    // uncovered a slider (the captured pawn too, for en passant).
+    attackers |= (getBmagic(to, occ) & diagonal) | (getRmagic(to, occ) & straight);
+    attackers &= occ;
 
-// Returns SEE score minus threshold. Positive means the capture wins material
-// relative to threshold (e.g. threshold=0 means any winning/equal capture).
-int SEE(const Board& brd, int from, int to, int threshold = 0) noexcept {
-    int movingPieceType = getMovingPieceType(brd, from);
-    if (movingPieceType == -1) return 0;
-    
-    bool isWhiteMoving = brd.White & (1ULL << from);
-    int capturedPieceType = getMovingPieceType(brd, to);
-    
-    uint64_t occ = brd.Occ;
-    uint64_t attackers = getAttackers(brd, to);
+    uint64_t whitePinners, blackPinners;
+    const uint64_t whitePinned = pinnedTo(brd, true, whitePinners);
+    const uint64_t blackPinned = pinnedTo(brd, false, blackPinners);
 
-    int seeValues[32];
-    int depth = 0;
+    bool side = !(brd.White & (1ULL << from));
+    // 1 while the side that made the last capture is ahead of threshold.
+    int res = 1;
+    while (true) {
+        uint64_t sideAttackers = attackers & (side ? brd.White : brd.Black);
+        if ((side ? whitePinners : blackPinners) & occ) {
+            sideAttackers &= ~(side ? whitePinned : blackPinned);
+        }
+        if (!sideAttackers) {
+            break;
+        }
+        res ^= 1;
 
-    // Promotion: pawn becomes a queen on the target square.
-    // Gain = queen value + whatever was captured there.
-    if (movingPieceType == 0 && (to <= 7 || to >= 56)) {
-        seeValues[0] = seePieceValues[4] + (capturedPieceType != -1 ? seePieceValues[capturedPieceType] : 0);
-        movingPieceType = 4; // the piece on the square is now a queen
-    }
-    else if (capturedPieceType == -1) {
-        seeValues[0] = 0;
-    }
-    else {
-        seeValues[0] = seePieceValues[capturedPieceType];
-    }
-
-    // Remove the moving piece from occ/attackers, then reveal x-rays behind it.
-    occ      &= ~(1ULL << from);
-    attackers &= ~(1ULL << from);
-    updateAttackers(attackers, brd, occ, from, to, movingPieceType);
-    
-    int lastPieceType = movingPieceType;
-    bool side = !isWhiteMoving;
-
-    while (attackers) {
-        int nextPieceType = -1;
-        int nextAttackerSquare = getLeastValuableAttacker(brd, to, side, attackers, nextPieceType);
-        if (nextAttackerSquare == -1) break;
-        
-        depth++;
-        // Standing pat: this side captures lastPieceType and risks nextPieceType.
-        seeValues[depth] = seePieceValues[lastPieceType] - seeValues[depth - 1];
-        lastPieceType = nextPieceType;
-        
-        occ      &= ~(1ULL << nextAttackerSquare);
-        attackers &= ~(1ULL << nextAttackerSquare);
-        updateAttackers(attackers, brd, occ, nextAttackerSquare, to, nextPieceType);
-        
+        // The least valuable attacker takes; only the slider rays through
+        // its square can reveal something new behind it.
+        uint64_t bb;
+        if ((bb = sideAttackers & (brd.WPawn | brd.BPawn))) {
+            if ((swap = seePieceValues[0] - swap) < res) break;
+            occ ^= bb & -bb;
+            attackers |= getBmagic(to, occ) & diagonal;
+        } else if ((bb = sideAttackers & (brd.WKnight | brd.BKnight))) {
+            if ((swap = seePieceValues[1] - swap) < res) break;
+            occ ^= bb & -bb;
+        } else if ((bb = sideAttackers & (brd.WBishop | brd.BBishop))) {
+            if ((swap = seePieceValues[2] - swap) < res) break;
+            occ ^= bb & -bb;
+            attackers |= getBmagic(to, occ) & diagonal;
+        } else if ((bb = sideAttackers & (brd.WRook | brd.BRook))) {
+            if ((swap = seePieceValues[3] - swap) < res) break;
+            occ ^= bb & -bb;
+            attackers |= getRmagic(to, occ) & straight;
+        } else if ((bb = sideAttackers & (brd.WQueen | brd.BQueen))) {
+            if ((swap = seePieceValues[4] - swap) < res) break;
+            occ ^= bb & -bb;
+            attackers |= (getBmagic(to, occ) & diagonal) | (getRmagic(to, occ) & straight);
+        } else {
+            // The king may only take when nothing defends the square.
+            return (attackers & ~(side ? brd.White : brd.Black)) ? res ^ 1 : res;
+        }
+        attackers &= occ;
         side = !side;
     }
-
-    // Negamax rollback: each side can choose not to capture (stand pat).
-    for (int i = depth; i > 0; i--) {
-        seeValues[i-1] = -std::max(-seeValues[i-1], seeValues[i]);
-    }
-
-    return seeValues[0] - threshold;
+    return res;
 }
@@ -1,4 +1,3 @@
 #pragma once
 
-int SEE(const Board& brd, int from, int to,int threshold) noexcept;
-
+bool seeGE(const Board& brd, EncodedMove move, int threshold) noexcept;
@@ -7,8 +7,11 @@
 #include "hash.hpp"
 #include "minimax_info.hpp"
 #include "movegen.hpp"
+#include "movepicker.hpp"
 #include "nnue.h"
 #include "parameter.hpp"
+#include "repetition.hpp"
+#include "uci.hpp"
 #include <atomic>
 #include <chrono>
 #include <cstdint>
@@ -34,16 +37,13 @@ struct SearchStats {
     uint64_t nodes;
     uint64_t nps;
     bool print;
+    // Nodes of every iteration so far, including an unfinished last one.
+    uint64_t totalNodes;
 };
 inline MovePV pvTable[MAX_SEARCH_DEPTH + 1][MAX_SEARCH_DEPTH + 1];
 inline int pvLength[MAX_SEARCH_DEPTH + 1];
 inline MovePV previousPvLine[MAX_SEARCH_DEPTH + 1];
 
-constexpr int MAX_KILLER_MOVES = 2;
-constexpr int MAX_KILLER_PLY = 99;
-
-static uint16_t killerMoves[MAX_KILLER_PLY][MAX_KILLER_MOVES] = {0};
-
 static int16_t captureHistory[2][64][64] = {0};
 static uint16_t counterHistoryTable[2][64][64] = {0};
 static uint16_t followUpTable[2][64][64] = {0};
@@ -88,35 +88,39 @@ inline void updateFollowUp(bool isWhite, uint8_t prevPrevFrom,
 }
 
 inline void updateKillerMoves(int ply, uint8_t from, uint8_t to) {
-    if (ply >= MAX_KILLER_PLY)
-        return;
-
+    uint16_t *killers = searchStack[ply].killers;
     uint16_t move = packMove(from, to);
 
-    if (killerMoves[ply][0] == move)
+    if (killers[0] == move)
         return;
 
-    killerMoves[ply][1] = killerMoves[ply][0];
-    killerMoves[ply][0] = move;
+    killers[1] = killers[0];
+    killers[0] = move;
 }
 
 inline int getKillerMoveBonus(uint8_t from, uint8_t to, int ply) {
+    const uint16_t *killers = searchStack[ply].killers;
     uint16_t move = packMove(from, to);
 
-    if (move == killerMoves[ply][0])
+    if (move == killers[0])
         return KILLER_MOVE_BONUS;
-    else if (move == killerMoves[ply][1])
+    else if (move == killers[1])
         return KILLER_MOVE_BONUS;
 
     return 0;
 }
 
-inline void resetKillerMoves() { memset(killerMoves, 0, sizeof(killerMoves)); }
-
-inline void sortMoves(Callback *array, int count) {
-    std::sort(array, array + count, [](const Callback &a, const Callback &b) {
-        return a.value > b.value;
-    });
+inline void sortMoves(MoveList &ml) {
+    std::pair<int, EncodedMove> sorted[256];
+    for (int i = 0; i < ml.count; i++) {
+        sorted[i] = {ml.scores[i], ml.moves[i]};
+    }
+    std::sort(sorted, sorted + ml.count,
+              [](const auto &a, const auto &b) { return a.first > b.first; });
+    for (int i = 0; i < ml.count; i++) {
+        ml.scores[i] = sorted[i].first;
+        ml.moves[i] = sorted[i].second;
+    }
 }
 
 inline int clamp(int value, int min, int max) {
@@ -128,24 +132,24 @@ inline int clamp(int value, int min, int max) {
     }
     return value;
 }
-inline void ageHistoryTable() {
+inline void ageHistoryTable(double factor) {
     for (int i = 0; i < 2; i++) {
         for (int from = 0; from < 64; from++) {
             for (int to = 0; to < 64; to++) {
-                historyTable[i][from][to] /= HISTORY_AGE_FACTOR;
-                captureHistory[i][from][to] /= HISTORY_AGE_FACTOR;
+                historyTable[i][from][to] /= factor;
+                captureHistory[i][from][to] /= factor;
             }
         }
     }
 }
-inline void clearHistoryTable() {
-    for (int i = 0; i < 2; i++) {
-        for (int from = 0; from < 64; from++) {
-            for (int to = 0; to < 64; to++) {
-                historyTable[i][from][to] = 0;
-            }
-        }
-    }
+// Move ordering tables carry over between searches, aged by
+// HISTORY_MOVE_AGE_FACTOR, until ucinewgame. With KEEP_HEURISTICS off every
+// search starts them empty.
+inline void clearHeuristics() {
+    memset(historyTable, 0, sizeof(historyTable));
+    memset(captureHistory, 0, sizeof(captureHistory));
+    memset(counterHistoryTable, 0, sizeof(counterHistoryTable));
+    memset(followUpTable, 0, sizeof(followUpTable));
 }
 
 #define MAX_HISTORY 10000
@@ -178,10 +182,6 @@ inline int quiescence(const Board &brd, minimax_info_t &info) noexcept {
     bool isCapture = info.isCapture;
 
     node_count++;
-    uint64_t kingBan = 0;
-    generateKingBan<status.IsWhite>(brd, kingBan);
-    bool inCheck = status.IsWhite ? (brd.WKing & kingBan) != 0
-                                  : (brd.BKing & kingBan) != 0;
 
     int standPat = -score;
     if (standPat >= beta)
@@ -189,40 +189,63 @@ inline int quiescence(const Board &brd, minimax_info_t &info) noexcept {
     if (standPat > alpha)
         alpha = standPat;
 
-    Callback ml[217];
-    int count = 0;
-
-    genMoves<status, 1, 1>(brd, ep, ml, count);
-    for (int i = 0; i < count; i++) {
-        ml[i].value += captureHistory[status.IsWhite][ml[i].from][ml[i].to];
-    }
-
-    sortMoves(ml, count);
-    for (int i = 0; i < count; i++) {
-        if (ml[i].value < 0) {
-            continue;
-        }
-
-        move_info_t moveInfo;
-        moveInfo.from = ml[i].from;
-        moveInfo.to = ml[i].to;
-        moveInfo.alpha = -beta;
-        moveInfo.beta = -alpha;
-        moveInfo.score = -score;
-        moveInfo.accPair = info.accPair;
-        moveInfo.key = key;
-        moveInfo.depth = 1;
-        moveInfo.irreversibleCount = irreversibleCount;
-        moveInfo.ply = ply;
-        moveInfo.isPVNode = false;
-        moveInfo.prevMove = &info;
-
-        int eval = -ml[i].move(brd, moveInfo);
-        if (eval >= beta) {
-            return beta;
+    // Captures come in MVV-LVA order straight from the bitboards, one
+    // victim type at a time, so a cutoff leaves the rest unemitted.
+    const CaptureTargets<status> captures(brd,
+                                          generateCheck<status.IsWhite>(brd));
+    const uint64_t victims[5] = {
+        status.IsWhite ? brd.BQueen : brd.WQueen,
+        status.IsWhite ? brd.BRook : brd.WRook,
+        status.IsWhite ? brd.BBishop : brd.WBishop,
+        status.IsWhite ? brd.BKnight : brd.WKnight,
+        status.IsWhite ? brd.BPawn : brd.WPawn};
+    static constexpr int victimValues[5] = {900, 500, 330, 320, 100};
+    // By pieceOn, pawn to king.
+    static constexpr int attackerValues[6] = {100, 320, 330, 500, 900, 0};
+    MoveList ml;
+    for (int v = 0; v < 5; v++) {
+        // Delta pruning: when even winning this victim for free leaves us
+        // short of alpha, so do all the cheaper ones after it. A promotion
+        // gains more than its victim, so those keep the captures coming.
+        if (standPat + victimValues[v] + DELTA_MARGIN <= alpha &&
+            !captures.promotes()) {
+            break;
         }
-        if (eval > alpha) {
-            alpha = eval;
+        ml.count = 0;
+        captures.emit(brd, victims[v], ml);
+        for (int i = 0; i < ml.count; i++) {
+            const EncodedMove move = ml.moves[i];
+            if (ml.scores[i] + captureHistory[status.IsWhite][moveFrom(move)]
+                                             [moveTo(move)] <
+                0) {
+                continue;
+            }
+            // A capture by a piece worth no more than its victim cannot
+            // lose material, so SEE only runs for the others.
+            if (attackerValues[brd.pieceOn(moveFrom(move))] > victimValues[v] &&
+                !seeGE(brd, move, -QS_SEE_MARGIN)) {
+                continue;
+            }
+
+            move_info_t moveInfo;
+            moveInfo.from = moveFrom(move);
+            moveInfo.to = moveTo(move);
+            moveInfo.alpha = -beta;
+            moveInfo.beta = -alpha;
+            moveInfo.accPair = info.accPair;
+            moveInfo.key = key;
+            moveInfo.depth = 1;
+            moveInfo.irreversibleCount = irreversibleCount;
+            moveInfo.ply = ply;
+            moveInfo.isPVNode = false;
+
+            int eval = -searchMove<status, true>(brd, move, moveInfo);
+            if (eval >= beta) {
+                return beta;
+            }
+            if (eval > alpha) {
+                alpha = eval;
+            }
         }
     }
 
@@ -252,8 +275,7 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
     int alpha = info.alpha;
     int beta = info.beta;
     AccumulatorPair *accPair = info.accPair;
-    info.score = nnue_evaluate(info.accPair, status.IsWhite);
-    int score = info.score;
+    int score = nnue_evaluate(info.accPair, status.IsWhite);
     uint64_t key = info.key;
     int depth = info.depth;
     int irreversibleCount = info.irreversibleCount;
@@ -265,20 +287,24 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
     bool nullMove = info.nullMove;
     node_count++;
 
-    bool improving = true;
+    SearchFrame &frame = searchStack[ply];
+    frame.staticEval = score;
+    frame.from = from;
+    frame.to = to;
+    frame.nullMove = nullMove;
+    const SearchFrame &parent = searchStack[ply - 1];
+    const SearchFrame &grandparent = searchStack[ply - 2];
+    frame.pliesFromNull = nullMove ? 0 : parent.pliesFromNull + 1;
 
-    if (info.prevMove != nullptr) {
-        if (info.prevMove->prevMove != nullptr) {
-            improving = score > info.prevMove->prevMove->score;
-        }
-    }
+    bool improving = score > grandparent.staticEval;
 
-    uint64_t kingBan = 0;
+    // Shared with the move picker; depth 0 hands over to quiescence, which
+    // computes its own.
+    AttackInfo attacks;
     if (depth >= 1) {
-        generateKingBan<status.IsWhite>(brd, kingBan);
+        attacks = generateCheck<status.IsWhite>(brd);
     }
-    bool inCheck = status.IsWhite ? (brd.WKing & kingBan) != 0
-                                  : (brd.BKing & kingBan) != 0;
+    bool inCheck = attacks.inCheck();
 
     // maybe (!isCapture)
     if ((!isPVNode) && (!inCheck) && (depth >= 1) && (depth <= RFP_DEPTH)) {
@@ -305,7 +331,6 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
         quiescenceInfo.ep = ep;
         quiescenceInfo.alpha = alpha;
         quiescenceInfo.beta = beta;
-        quiescenceInfo.score = score;
         quiescenceInfo.accPair = info.accPair;
         quiescenceInfo.key = key;
         quiescenceInfo.depth = 5;
@@ -313,21 +338,29 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
         quiescenceInfo.ply = 0;
         quiescenceInfo.isPVNode = isPVNode;
         quiescenceInfo.isCapture = 0;
-        quiescenceInfo.prevMove = &info;
         quiescenceInfo.from = from;
         quiescenceInfo.to = to;
 
         return quiescence<status>(brd, quiescenceInfo);
     } else {
-        prevHash.push_back(key);
-        if (irreversibleCount >= 3) {
-            if (std::count(prevHash.end() -
-                               std::min<size_t>(irreversibleCount + 1,
-                                                prevHash.size()),
-                           prevHash.end(), key) >= 2) {
-                prevHash.pop_back();
-                return (status.IsWhite == white) ? -CONTEMPT_FACTOR
-                                                 : CONTEMPT_FACTOR;
+        const int drawScore =
+            (status.IsWhite == white) ? -CONTEMPT_FACTOR : CONTEMPT_FACTOR;
+        const int reversible = std::min(irreversibleCount, frame.pliesFromNull);
+        repetitions.push(key);
+        if (repetitions.repeated(reversible)) {
+            repetitions.pop();
+            return drawScore;
+        }
+        // A move back into an earlier position is a draw we can force, so
+        // the node is worth at least that.
+        if (reversible >= 3 && alpha < drawScore &&
+            repetitions.upcoming(brd.Occ,
+                                 status.IsWhite ? brd.White : brd.Black,
+                                 reversible)) {
+            alpha = drawScore;
+            if (alpha >= beta) {
+                repetitions.pop();
+                return alpha;
             }
         }
 
@@ -349,7 +382,7 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
             toHash = val.to;
             if (val.value != UNKNOWN) {
 
-                prevHash.pop_back();
+                repetitions.pop();
                 return val.value;
             }
         }
@@ -358,6 +391,13 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
             ttHit = true;
         }
 
+        // With no hash or PV move to search first the ordering is a guess,
+        // so search a ply shallower. The move this stores in the TT leads
+        // the next, deeper visit.
+        if (!ttHit && expectedPvMove.from == 255 && depth >= IIR_DEPTH) {
+            depth--;
+        }
+
         bool hasSufficientMaterial = true;
         if (status.IsWhite) {
             hasSufficientMaterial =
@@ -367,8 +407,7 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
                 (brd.BQueen | brd.BRook | brd.BBishop | brd.BKnight) != 0;
         }
 
-        bool prevMoveIsNull =
-            info.prevMove != nullptr && info.prevMove->nullMove;
+        bool prevMoveIsNull = parent.nullMove;
 
         if (!ttHit && depth > 2 && !inCheck && !isPVNode && !isCapture &&
             !nullMove && !prevMoveIsNull && hasSufficientMaterial) {
@@ -380,10 +419,9 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
                            status.BLC, status.BRC);
 
             minimax_info_t nullMoveInfo;
-            nullMoveInfo.ep = ep;
+            nullMoveInfo.ep = -1;
             nullMoveInfo.alpha = -beta;
             nullMoveInfo.beta = -beta + 1;
-            nullMoveInfo.score = -score;
             nullMoveInfo.accPair = info.accPair;
             nullMoveInfo.key = toggle_side_to_move(key);
             nullMoveInfo.depth = depth - R;
@@ -392,62 +430,78 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
             nullMoveInfo.isPVNode = false;
             nullMoveInfo.isCapture = false;
             nullMoveInfo.nullMove = true;
-            nullMoveInfo.prevMove = &info;
             nullMoveInfo.from = 255;
             nullMoveInfo.to = 255;
             int nullMoveScore = -minimax<NextState>(brd, nullMoveInfo);
 
             if (nullMoveScore >= beta) {
-                prevHash.pop_back();
+                repetitions.pop();
                 return nullMoveScore;
             }
         }
 
-        Callback ml[217];
-        int count = 0;
-
-        uint64_t kingBan = genMoves<status, 1, 0>(brd, ep, ml, count);
+        // ProbCut: a capture that SEE says wins enough and that still beats
+        // beta by a margin in a shallow zero-window search would almost
+        // surely cut at full depth too.
+        const int probCutBeta = beta + PROBCUT_MARGIN;
+        if (!isPVNode && !inCheck && depth >= PROBCUT_DEPTH &&
+            std::abs(beta) < 90000) {
+            MoveList noisy;
+            genMoves<status, 1, MoveGen::Noisy>(brd, ep, noisy, attacks);
+            const int seeThreshold = std::max(0, probCutBeta - (-score));
+            for (int i = 0; i < noisy.count; i++) {
+                const EncodedMove move = noisy.moves[i];
+                const int from = moveFrom(move);
+                const int to = moveTo(move);
+                if (!seeGE(brd, move, seeThreshold)) {
+                    continue;
+                }
 
-        for (int i = 0; i < count; i++) {
-            if (ml[i].from == fromHash && ml[i].to == toHash) {
-                ml[i].value += TT_MOVE_BONUS;
-            }
-            if (ml[i].from == expectedPvMove.from &&
-                ml[i].to == expectedPvMove.to) {
-                ml[i].value += PV_MOVE_BONUS;
-            }
-            if (!ml[i].capture && !ml[i].promotion) {
-                ml[i].value += getKillerMoveBonus(ml[i].from, ml[i].to, ply);
-            } else {
-                ml[i].value +=
-                    captureHistory[status.IsWhite][ml[i].from][ml[i].to];
-            }
-            if (!ml[i].capture && info.prevMove != nullptr &&
-                !info.prevMove->nullMove) {
-                ml[i].value += getCounterHistoryBonus(
-                    status.IsWhite, info.prevMove->from, info.prevMove->to,
-                    ml[i].from, ml[i].to);
-            }
-            if (!ml[i].capture && info.prevMove != nullptr &&
-                info.prevMove->prevMove != nullptr &&
-                !info.prevMove->prevMove->nullMove) {
-                ml[i].value += getFollowUpBonus(
-                    status.IsWhite, info.prevMove->prevMove->from,
-                    info.prevMove->prevMove->to, ml[i].from, ml[i].to);
+                move_info_t moveInfo;
+                moveInfo.from = from;
+                moveInfo.to = to;
+                moveInfo.alpha = -probCutBeta;
+                moveInfo.beta = -probCutBeta + 1;
+                moveInfo.accPair = info.accPair;
+                moveInfo.key = key;
+                moveInfo.irreversibleCount = irreversibleCount;
+                moveInfo.ply = ply + 1;
+                moveInfo.isPVNode = false;
+                // Quiescence first weeds out most candidates cheaply.
+                moveInfo.depth = 0;
+                int eval = -searchMove<status, false>(brd, move, moveInfo);
+                if (eval >= probCutBeta) {
+                    moveInfo.depth = depth - PROBCUT_REDUCTION;
+                    eval = -searchMove<status, false>(brd, move, moveInfo);
+                }
+                if (shouldStop.load()) {
+                    break;
+                }
+                if (eval >= probCutBeta) {
+                    TT.store(depth - PROBCUT_REDUCTION + 1, eval, 2, key, from,
+                             to);
+                    repetitions.pop();
+                    return eval;
+                }
             }
         }
 
-        sortMoves(ml, count);
-
-        bool outOfMoves = (count == 0);
-        if (outOfMoves && inCheck) {
-            prevHash.pop_back();
-            return (-99999 + ply);
-        }
-        if (outOfMoves) {
-            prevHash.pop_back();
-            return 0;
-        }
+        const bool hasPrev = parent.from < 64;
+        const bool hasPrevPrev = grandparent.from < 64;
+
+        MovePicker<status> picker(
+            brd, ep, attacks,
+            packMove(expectedPvMove.from, expectedPvMove.to),
+            packMove(fromHash, toHash),
+            frame.killers[0], frame.killers[1],
+            hasPrev ? counterHistoryTable[status.IsWhite][parent.from]
+                                         [parent.to]
+                    : NO_MOVE,
+            hasPrevPrev
+                ? followUpTable[status.IsWhite][grandparent.from]
+                               [grandparent.to]
+                : NO_MOVE,
+            captureHistory[status.IsWhite]);
 
         bool futilityPruning = false;
         int futilityMargin = 0;
@@ -461,30 +515,59 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
                 futilityPruning = true;
             }
         }
-        int maxIndex = -1;
+        int bestFrom = 255;
+        int bestTo = 255;
         int bestEval = -99999;
         bool firstMove = true;
 
-        int extension =
-            calculateExtension(isCapture, inCheck, isPVNode, count == 1);
+        // The picker does not count the moves up front. Evasions are few, so
+        // in check they are generated once to spot a forced reply.
+        int replyCount = 0;
+        if (inCheck) {
+            MoveList evasions;
+            genMoves<status, 1, MoveGen::All>(brd, ep, evasions, attacks);
+            replyCount = evasions.count;
+        }
+        int extension = calculateExtension(isCapture, inCheck, isPVNode,
+                                           replyCount == 1);
         static const int LMP_TABLE[2][9] = {
             {0, 3, 7, 12, 18, 25, 35, 48, 64}, // not improving
             {0, 6, 12, 20, 30, 42, 56, 72, 90}};
 
+        // Quiet checks are kept out of futility pruning.
+        CheckSquares checkSquares;
+        if (futilityPruning) {
+            checkSquares = generateCheckSquares<status.IsWhite>(brd);
+        }
+
+        EncodedMove move;
+        EncodedMove triedQuiets[64];
+        int triedQuietCount = 0;
+        int moveCount = 0;
         int quietCount = 0;
-        for (int i = 0; i < count; i++) {
+        while (picker.next(move)) {
+            moveCount++;
+            const int from = moveFrom(move);
+            const int to = moveTo(move);
+            const bool isQuiet = isQuietMove(move);
+            // A cutoff penalizes every quiet ordered before it, pruned or not.
+            if (isQuiet && triedQuietCount < 64) {
+                triedQuiets[triedQuietCount++] = move;
+            }
 
-            if (futilityPruning && i > 0 && !ml[i].capture &&
-                !ml[i].promotion && !inCheck) {
+            if (futilityPruning && moveCount > 1 && isQuiet &&
+                !givesCheck<status.IsWhite>(brd, checkSquares, move)) {
+                picker.onlyQuietChecks(checkSquares);
                 continue;
             }
 
-            if (!ml[i].capture && !ml[i].promotion) {
+            if (isQuiet) {
                 quietCount++;
                 if (depth <= LMP_DEPTH_MAX) {
                     int lmpLimit =
                         LMP_TABLE[improving ? 1 : 0][depth] * LMP_SCALE / 100;
                     if (quietCount >= lmpLimit) {
+                        picker.skipQuiets();
                         continue;
                     }
                 }
@@ -494,40 +577,34 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
             bool doFullSearch = true;
             int reduction = 0;
 
-            if (!ml[i].capture && !ml[i].promotion && depth >= LMR_DEPTH_MIN &&
-                quietCount > 1) {
-                float baseRed =
-                    LMR_BASE +
-                    int(std::log(depth) * std::log(quietCount) / (LMR_DIV));
-                int hist = historyTable[status.IsWhite][ml[i].from][ml[i].to];
-
-                baseRed += !isPVNode + !improving;
+            if (isQuiet && depth >= LMR_DEPTH_MIN && quietCount > 1) {
+                int hist = historyTable[status.IsWhite][from][to];
+                int adjust = !isPVNode + !improving;
 
-                baseRed += (inCheck && (((brd.WKing >> ml[i].from) & 1) ||
-                                        ((brd.BKing >> ml[i].from) & 1)));
+                adjust += (inCheck && (((brd.WKing >> from) & 1) ||
+                                       ((brd.BKing >> from) & 1)));
 
-                baseRed +=
-                    std::max(-LMR_HIST_MAX,
-                             std::min(LMR_HIST_MAX, -hist / LMR_HIST_DIV));
-                reduction = std::clamp((int)baseRed, 1, depth - 1);
+                adjust += std::max(-LMR_HIST_MAX,
+                                   std::min(LMR_HIST_MAX, -hist / LMR_HIST_DIV));
+                reduction = std::clamp(
+                    (LMR_TABLE[depth][quietCount] + adjust * LMR_ONE) / LMR_ONE,
+                    1, depth - 1);
             }
 
             if (reduction > 0) {
                 doFullSearch = false;
                 move_info_t moveInfo;
-                moveInfo.from = ml[i].from;
-                moveInfo.to = ml[i].to;
+                moveInfo.from = from;
+                moveInfo.to = to;
                 moveInfo.alpha = -alpha - 1;
                 moveInfo.beta = -alpha;
-                moveInfo.score = -score;
                 moveInfo.accPair = info.accPair;
                 moveInfo.key = key;
                 moveInfo.depth = depth - reduction;
                 moveInfo.irreversibleCount = irreversibleCount;
                 moveInfo.ply = ply + 1;
                 moveInfo.isPVNode = false;
-                moveInfo.prevMove = &info;
-                eval = -ml[i].move(brd, moveInfo);
+                eval = -searchMove<status, false>(brd, move, moveInfo);
                 if (eval > alpha) {
                     doFullSearch = true;
                 }
@@ -535,30 +612,28 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
 
             if (doFullSearch) {
                 move_info_t moveInfo;
-                moveInfo.from = ml[i].from;
-                moveInfo.to = ml[i].to;
+                moveInfo.from = from;
+                moveInfo.to = to;
                 moveInfo.alpha = -beta;
                 moveInfo.beta = -alpha;
-                moveInfo.score = -score;
                 moveInfo.accPair = info.accPair;
                 moveInfo.key = key;
                 moveInfo.depth = depth - 1 + extension;
                 moveInfo.irreversibleCount = irreversibleCount;
                 moveInfo.ply = ply + 1;
                 moveInfo.isPVNode = isPVNode;
-                moveInfo.prevMove = &info;
 
                 if (firstMove) {
-                    eval = -ml[i].move(brd, moveInfo);
+                    eval = -searchMove<status, false>(brd, move, moveInfo);
                 } else {
                     moveInfo.alpha = -alpha - 1;
                     moveInfo.isPVNode = false;
-                    eval = -ml[i].move(brd, moveInfo);
+                    eval = -searchMove<status, false>(brd, move, moveInfo);
 
                     if (eval > alpha && eval < beta) {
                         moveInfo.alpha = -beta;
                         moveInfo.isPVNode = isPVNode;
-                        eval = -ml[i].move(brd, moveInfo);
+                        eval = -searchMove<status, false>(brd, move, moveInfo);
                     }
                 }
             }
@@ -567,14 +642,15 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
 
             if (eval > bestEval) {
                 bestEval = eval;
-                maxIndex = i;
+                bestFrom = from;
+                bestTo = to;
                 if (eval > alpha) {
                     hashf = 0;
                     alpha = eval;
 
                     if (ply <= MAX_SEARCH_DEPTH) {
-                        pvTable[ply][0].from = ml[i].from;
-                        pvTable[ply][0].to = ml[i].to;
+                        pvTable[ply][0].from = from;
+                        pvTable[ply][0].to = to;
                         if (ply + 1 <= MAX_SEARCH_DEPTH) {
                             memcpy(&pvTable[ply][1], &pvTable[ply + 1][0],
                                    pvLength[ply + 1] * sizeof(MovePV));
@@ -588,72 +664,160 @@ inline int minimax(const Board &brd, minimax_info_t &info) noexcept {
 
             // move is to good
             if (eval >= beta) {
-                if (!ml[i].capture && !ml[i].promotion) {
-                    updateHistory<status.IsWhite>(ml[i].from, ml[i].to,
+                if (isQuiet) {
+                    updateHistory<status.IsWhite>(from, to,
                                                   depth * depth);
-                    updateKillerMoves(ply, ml[i].from, ml[i].to);
-                    if (info.prevMove != nullptr && !info.prevMove->nullMove) {
+                    updateKillerMoves(ply, from, to);
+                    if (hasPrev) {
                         updateCounterHistory(
-                            status.IsWhite, info.prevMove->from,
-                            info.prevMove->to, ml[i].from, ml[i].to);
+                            status.IsWhite, parent.from, parent.to, from, to);
                     }
                 } else {
-                    updateCaptureHistory<status.IsWhite>(ml[i].from, ml[i].to,
+                    updateCaptureHistory<status.IsWhite>(from, to,
                                                          depth * depth);
                 }
-                for (int j = 0; j < i; j++) {
-                    if (!ml[j].capture && !ml[j].promotion) {
-                        updateHistory<status.IsWhite>(ml[j].from, ml[j].to,
+                for (int j = 0; j < triedQuietCount; j++) {
+                    if (triedQuiets[j] != move) {
+                        updateHistory<status.IsWhite>(moveFrom(triedQuiets[j]),
+                                                      moveTo(triedQuiets[j]),
                                                       -depth);
                     }
                 }
                 if (depth > TT_PROBE_MIN_DEPTH) {
-                    TT.store(depth, beta, 2, key, ml[i].from, ml[i].to);
+                    TT.store(depth, beta, 2, key, from, to);
                 }
-                prevHash.pop_back();
+                repetitions.pop();
                 return bestEval;
             }
+
+        }
+
+        if (moveCount == 0) {
+            repetitions.pop();
+            return inCheck ? (-99999 + ply) : 0;
         }
         if (shouldStop.load()) {
-            prevHash.pop_back();
+            repetitions.pop();
             return beta;
         }
-        if (depth > 1) {
-            TT.store(depth, alpha, hashf, key, ml[maxIndex].from,
-                     ml[maxIndex].to);
+        if (depth > 1 && bestFrom != 255) {
+            TT.store(depth, alpha, hashf, key, bestFrom, bestTo);
         }
-        prevHash.pop_back();
+        repetitions.pop();
         return bestEval;
     }
 }
 
-inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
-                             bool WL, bool WR, bool BL, bool BR, int depth,
-                             int irreversibleCount, int &previousEval,
-                             int &bestFrom, int &bestTo, SearchStats &stats) {
+// Root moves for one go. They are generated once and reordered after every
+// iteration: the best move first, then the noisy moves in their first
+// order, then the quiets by how many nodes their subtrees took (ranking the
+// captures that way too searched more). The root key and accumulator are
+// shared by all iterations.
+struct RootMove {
+    EncodedMove move;
+    // Both from the latest iteration that searched the move.
+    uint64_t nodes;
+    int score;
+};
+
+struct RootMoves {
+    RootMove moves[256];
+    int count = 0;
+    uint64_t key;
+    bool inCheck;
+    AccumulatorPair *accPair;
+
+    RootMoves(const Board &brd, int ep, bool WH, bool EP, bool WL, bool WR,
+              bool BL, bool BR) {
+        MoveList ml;
+        moveGenCall<1, MoveGen::All>(brd, ep, ml, WH, EP, WL, WR, BL, BR);
+        key = create_hash(brd, WH);
+
+        // Before the first iteration there is only the TT move from earlier
+        // searches and capture history to go on.
+        res val = TT.probe_hash(0, -99999, 99999, key);
+        for (int i = 0; i < ml.count; i++) {
+            const int from = moveFrom(ml.moves[i]);
+            const int to = moveTo(ml.moves[i]);
+            if (from == val.from && to == val.to) {
+                ml.scores[i] += TT_MOVE_BONUS;
+            }
+            if (!isQuietMove(ml.moves[i])) {
+                ml.scores[i] += captureHistory[WH][from][to];
+            }
+        }
+        sortMoves(ml);
+        for (int i = 0; i < ml.count; i++) {
+            moves[count++] = RootMove{ml.moves[i], 0, -99999};
+        }
+
+        uint64_t kingBan = 0;
+        if (WH) {
+            generateKingBan<1>(brd, kingBan);
+        } else {
+            generateKingBan<0>(brd, kingBan);
+        }
+        inCheck = WH ? (brd.WKing & kingBan) != 0 : (brd.BKing & kingBan) != 0;
+
+        accPair = (AccumulatorPair *)aligned_alloc(64, sizeof(AccumulatorPair));
+        nnue_init(accPair, brd);
+    }
+
+    ~RootMoves() { free(accPair); }
+
+    RootMoves(const RootMoves &) = delete;
+    RootMoves &operator=(const RootMoves &) = delete;
+
+    // After a completed iteration whose best move was moves[best].
+    void reorder(int best) {
+        std::rotate(moves, moves + best, moves + best + 1);
+        std::stable_sort(moves + 1, moves + count,
+                         [](const RootMove &a, const RootMove &b) {
+                             const bool quietA = isQuietMove(a.move);
+                             const bool quietB = isQuietMove(b.move);
+                             if (quietA != quietB) {
+                                 return quietB;
+                             }
+                             if (!quietA || a.nodes == b.nodes) {
+                                 return quietA && a.score > b.score;
+                             }
+                             return a.nodes > b.nodes;
+                         });
+        for (int i = 0; i < count; i++) {
+            moves[i].nodes = 0;
+        }
+    }
+};
+
+// Searches the root moves to `depth` and returns the index of the best one,
+// -1 if the search was stopped before any finished.
+inline int findBestMove(const Board &brd, RootMoves &root, bool WH, bool EP,
+                        bool WL, bool WR, bool BL, bool BR, int depth,
+                        int irreversibleCount, int &previousEval,
+                        SearchStats &stats) {
     node_count = 0;
     auto start = std::chrono::high_resolution_clock::now();
-    Callback ml[217];
-    int count = 0;
+
+    // The root knows its state only at runtime, so each root move goes
+    // through one dispatch into the templated search.
+    auto searchRoot = [&](int index, move_info_t &moveInfo) {
+        const long before = node_count;
+        const int eval =
+            stateCall(WH, EP, WL, WR, BL, BR, [&]<BoardState status>() {
+                return searchMove<status, false>(brd, root.moves[index].move,
+                                                 moveInfo);
+            });
+        root.moves[index].nodes += node_count - before;
+        return eval;
+    };
 
     if (0 <= MAX_SEARCH_DEPTH) {
         pvLength[0] = 0;
     }
 
-    uint64_t kingBan = 0;
-    if (WH) {
-        generateKingBan<1>(brd, kingBan);
-    } else {
-        generateKingBan<0>(brd, kingBan);
-    }
-    bool inCheck = WH ? (brd.WKing & kingBan) != 0 : (brd.BKing & kingBan) != 0;
-
-    AccumulatorPair *accPair =
-        (AccumulatorPair *)malloc(sizeof(AccumulatorPair));
-    nnue_init(accPair, brd);
-    int score;
-    score = nnue_evaluate(accPair, WH);
-    uint64_t key = create_hash(brd, WH);
+    const bool inCheck = root.inCheck;
+    AccumulatorPair *accPair = root.accPair;
+    const uint64_t key = root.key;
     int bestEval = -100000;
     int bestMoveIndex = -1;
     int alpha = -99999;
@@ -661,33 +825,7 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
 
     bool firstMove = true;
 
-    moveGenCall<1, 0>(brd, ep, ml, count, WH, EP, WL, WR, BL, BR);
-    uint8_t fromHash = 255;
-    uint8_t toHash = 255;
-    if (depth != 1) {
-        res val = TT.probe_hash(depth, alpha, beta, key);
-        fromHash = val.from;
-        toHash = val.to;
-    }
-
-    MovePV expectedRootPvMove =
-        (previousPvLineLength > 0) ? previousPvLine[0] : MovePV{255, 255};
-    for (int i = 0; i < count; i++) {
-        if (ml[i].from == expectedRootPvMove.from &&
-            ml[i].to == expectedRootPvMove.to) {
-            ml[i].value += PV_MOVE_BONUS;
-        }
-        if (ml[i].from == fromHash && ml[i].to == toHash) {
-            ml[i].value += TT_MOVE_BONUS;
-        }
-        if (!ml[i].capture && !ml[i].promotion) {
-            ml[i].value += getKillerMoveBonus(ml[i].from, ml[i].to, 1);
-        } else {
-            ml[i].value += captureHistory[WH][ml[i].from][ml[i].to];
-        }
-    }
-
-    sortMoves(ml, count);
+    const int count = root.count;
 
     if (depth > 5) {
         // aspiration search
@@ -706,47 +844,47 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
             bestMoveIndex = -1;
             int quietCount = 0;
             for (int i = 0; i < count; i++) {
+                const EncodedMove move = root.moves[i].move;
+                const int from = moveFrom(move);
+                const int to = moveTo(move);
+                const bool isQuiet = isQuietMove(move);
                 int eval;
                 bool doFullSearch = true;
                 int reduction = 0;
-                if (!ml[i].capture && !ml[i].promotion) {
+                if (isQuiet) {
                     quietCount++;
                 }
 
-                if (!ml[i].capture && !ml[i].promotion &&
+                if (isQuiet &&
                     depth >= LMR_DEPTH_MIN && quietCount > 1) {
-                    float baseRed =
-                        LMR_BASE +
-                        int(std::log(depth) * std::log(quietCount) / (LMR_DIV));
-                    int hist = historyTable[WH][ml[i].from][ml[i].to];
-
-                    baseRed += !firstMove;
-
-                    baseRed += (inCheck && (((brd.WKing >> ml[i].from) & 1) ||
-                                            ((brd.BKing >> ml[i].from) & 1)));
-
-                    baseRed +=
-                        std::max(-LMR_HIST_MAX,
-                                 std::min(LMR_HIST_MAX, -hist / LMR_HIST_DIV));
-                    reduction = std::clamp((int)baseRed, 1, depth - 1);
+                    int hist = historyTable[WH][from][to];
+                    int adjust = !firstMove;
+
+                    adjust += (inCheck && (((brd.WKing >> from) & 1) ||
+                                           ((brd.BKing >> from) & 1)));
+
+                    adjust += std::max(
+                        -LMR_HIST_MAX, std::min(LMR_HIST_MAX, -hist / LMR_HIST_DIV));
+                    reduction = std::clamp(
+                        (LMR_TABLE[depth][quietCount] + adjust * LMR_ONE) /
+                            LMR_ONE,
+                        1, depth - 1);
                 }
 
                 if (reduction > 0) {
                     doFullSearch = false;
                     move_info_t moveInfo;
-                    moveInfo.from = ml[i].from;
-                    moveInfo.to = ml[i].to;
+                    moveInfo.from = from;
+                    moveInfo.to = to;
                     moveInfo.alpha = -alpha - 1;
                     moveInfo.beta = -alpha;
-                    moveInfo.score = score;
                     moveInfo.accPair = accPair;
                     moveInfo.key = key;
                     moveInfo.depth = depth - reduction;
                     moveInfo.irreversibleCount = irreversibleCount;
                     moveInfo.ply = 1;
                     moveInfo.isPVNode = false;
-                    moveInfo.prevMove = nullptr;
-                    eval = -ml[i].move(brd, moveInfo);
+                    eval = -searchRoot(i, moveInfo);
                     if (eval > alpha) {
                         doFullSearch = true;
                     }
@@ -754,43 +892,42 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
 
                 if (doFullSearch) {
                     move_info_t moveInfo;
-                    moveInfo.from = ml[i].from;
-                    moveInfo.to = ml[i].to;
+                    moveInfo.from = from;
+                    moveInfo.to = to;
                     moveInfo.alpha = -beta;
                     moveInfo.beta = -alpha;
-                    moveInfo.score = score;
                     moveInfo.accPair = accPair;
                     moveInfo.key = key;
                     moveInfo.depth = depth - 1;
                     moveInfo.irreversibleCount = irreversibleCount;
                     moveInfo.ply = 1;
                     moveInfo.isPVNode = firstMove;
-                    moveInfo.prevMove = nullptr;
 
                     if (firstMove) {
-                        eval = -ml[i].move(brd, moveInfo);
+                        eval = -searchRoot(i, moveInfo);
                     } else {
                         moveInfo.alpha = -alpha - 1;
                         moveInfo.isPVNode = false;
-                        eval = -ml[i].move(brd, moveInfo);
+                        eval = -searchRoot(i, moveInfo);
 
                         if (eval > alpha && eval < beta) {
                             moveInfo.alpha = -beta;
                             moveInfo.isPVNode = firstMove;
-                            eval = -ml[i].move(brd, moveInfo);
+                            eval = -searchRoot(i, moveInfo);
                         }
                     }
                 }
 
                 firstMove = false;
+                root.moves[i].score = eval;
 
                 if (eval > bestEval) {
                     bestEval = eval;
                     bestMoveIndex = i;
                     alpha = eval;
 
-                    pvTable[0][0].from = ml[i].from;
-                    pvTable[0][0].to = ml[i].to;
+                    pvTable[0][0].from = from;
+                    pvTable[0][0].to = to;
                     if (pvLength[1] > 0) {
                         memcpy(&pvTable[0][1], &pvTable[1][0],
                                pvLength[1] * sizeof(MovePV));
@@ -822,46 +959,45 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
     if (depth < 6) {
         int quietCount = 0;
         for (int i = 0; i < count; i++) {
+            const EncodedMove move = root.moves[i].move;
+            const int from = moveFrom(move);
+            const int to = moveTo(move);
+            const bool isQuiet = isQuietMove(move);
             int eval;
             bool doFullSearch = true;
             int reduction = 0;
-            if (!ml[i].capture && !ml[i].promotion) {
+            if (isQuiet) {
                 quietCount++;
             }
 
-            if (!ml[i].capture && !ml[i].promotion && depth >= LMR_DEPTH_MIN &&
+            if (isQuiet && depth >= LMR_DEPTH_MIN &&
                 quietCount > 1) {
-                float baseRed =
-                    LMR_BASE +
-                    int(std::log(depth) * std::log(quietCount) / (LMR_DIV));
-                int hist = historyTable[WH][ml[i].from][ml[i].to];
+                int hist = historyTable[WH][from][to];
+                int adjust = !firstMove;
 
-                baseRed += !firstMove;
+                adjust += (inCheck && (((brd.WKing >> from) & 1) ||
+                                       ((brd.BKing >> from) & 1)));
 
-                baseRed += (inCheck && (((brd.WKing >> ml[i].from) & 1) ||
-                                        ((brd.BKing >> ml[i].from) & 1)));
-
-                baseRed +=
-                    std::max(-LMR_HIST_MAX,
-                             std::min(LMR_HIST_MAX, -hist / LMR_HIST_DIV));
-                reduction = std::clamp((int)baseRed, 1, depth - 1);
+                adjust += std::max(-LMR_HIST_MAX,
+                                   std::min(LMR_HIST_MAX, -hist / LMR_HIST_DIV));
+                reduction = std::clamp(
+                    (LMR_TABLE[depth][quietCount] + adjust * LMR_ONE) / LMR_ONE,
+                    1, depth - 1);
             }
             if (reduction > 0) {
                 doFullSearch = false;
                 move_info_t moveInfo;
-                moveInfo.from = ml[i].from;
-                moveInfo.to = ml[i].to;
+                moveInfo.from = from;
+                moveInfo.to = to;
                 moveInfo.alpha = -alpha - 1;
                 moveInfo.beta = -alpha;
-                moveInfo.score = score;
                 moveInfo.accPair = accPair;
                 moveInfo.key = key;
                 moveInfo.depth = depth - reduction;
                 moveInfo.irreversibleCount = irreversibleCount;
                 moveInfo.ply = 1;
                 moveInfo.isPVNode = false;
-                moveInfo.prevMove = nullptr;
-                eval = -ml[i].move(brd, moveInfo);
+                eval = -searchRoot(i, moveInfo);
                 if (eval > alpha) {
                     doFullSearch = true;
                 }
@@ -869,30 +1005,28 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
 
             if (doFullSearch) {
                 move_info_t moveInfo;
-                moveInfo.from = ml[i].from;
-                moveInfo.to = ml[i].to;
+                moveInfo.from = from;
+                moveInfo.to = to;
                 moveInfo.alpha = -beta;
                 moveInfo.beta = -alpha;
-                moveInfo.score = score;
                 moveInfo.accPair = accPair;
                 moveInfo.key = key;
                 moveInfo.depth = depth - 1;
                 moveInfo.irreversibleCount = irreversibleCount;
                 moveInfo.ply = 1;
                 moveInfo.isPVNode = firstMove;
-                moveInfo.prevMove = nullptr;
 
                 if (firstMove) {
-                    eval = -ml[i].move(brd, moveInfo);
+                    eval = -searchRoot(i, moveInfo);
                 } else {
                     moveInfo.alpha = -alpha - 1;
                     moveInfo.isPVNode = false;
-                    eval = -ml[i].move(brd, moveInfo);
+                    eval = -searchRoot(i, moveInfo);
 
                     if (eval > alpha && eval < beta) {
                         moveInfo.alpha = -beta;
                         moveInfo.isPVNode = firstMove;
-                        eval = -ml[i].move(brd, moveInfo);
+                        eval = -searchRoot(i, moveInfo);
                     }
                 }
             }
@@ -901,13 +1035,14 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
             if (shouldStop.load()) {
                 break;
             }
+            root.moves[i].score = eval;
             if (eval > bestEval) {
                 bestEval = eval;
                 bestMoveIndex = i;
                 alpha = eval;
 
-                pvTable[0][0].from = ml[i].from;
-                pvTable[0][0].to = ml[i].to;
+                pvTable[0][0].from = from;
+                pvTable[0][0].to = to;
                 if (pvLength[1] > 0) {
                     memcpy(&pvTable[0][1], &pvTable[1][0],
                            pvLength[1] * sizeof(MovePV));
@@ -919,17 +1054,18 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
         }
     }
     if (bestMoveIndex != -1) {
-        bestFrom = ml[bestMoveIndex].from;
-        bestTo = ml[bestMoveIndex].to;
         previousEval = bestEval;
     }
-    free(accPair);
+    stats.totalNodes += node_count;
     // print the stats
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> duration = end - start;
     int nps = ((double)node_count) / duration.count();
     if (!shouldStop.load()) {
-        TT.store(depth, bestEval, 0, key, bestFrom, bestTo);
+        if (bestMoveIndex != -1) {
+            const EncodedMove best = root.moves[bestMoveIndex].move;
+            TT.store(depth, bestEval, 0, key, moveFrom(best), moveTo(best));
+        }
         if (stats.print) {
             printf("info depth %d score cp %d nodes %ld nps %d time %d", depth,
                    bestEval, node_count, nps, (int)(1000 * duration.count()));
@@ -942,36 +1078,28 @@ inline Callback findBestMove(const Board &brd, int ep, bool WH, bool EP,
         //     pvTable[0][i].to).c_str());
         // }
     }
-    count = 0;
-
-    // find the make version of the move
-    moveGenCall<0, 0>(brd, ep, ml, count, WH, EP, WL, WR, BL, BR);
-    for (int i = 0; i < count; i++) {
-        if (ml[i].from == bestFrom && ml[i].to == bestTo) {
-            return ml[i];
-        }
-    }
-    std::cout << "Error: Best move not found in move list!" << bestFrom << " "
-              << bestTo << std::endl;
-    assert(false);
-    return ml[0];
+    return bestMoveIndex;
 }
 
-inline Callback iterative_deepening(const Board &brd, int ep, bool WH, bool EP,
-                                    bool WL, bool WR, bool BL, bool BR,
-                                    double timeLimit, int irreversibleCount,
-                                    SearchStats &stats, int max_depth) {
+inline EncodedMove iterative_deepening(const Board &brd, int ep, bool WH,
+                                       bool EP, bool WL, bool WR, bool BL,
+                                       bool BR, double timeLimit,
+                                       int irreversibleCount,
+                                       SearchStats &stats, int max_depth) {
     TT.age++;
-    resetKillerMoves();
+    searchStack.reset();
     using clock = std::chrono::high_resolution_clock;
     auto start = clock::now();
     shouldStop.store(false);
 
-    Callback bestMove{};
+    EncodedMove bestMove = 0;
     int eval = 0;
     std::thread timerThread([&] {
         while (true) {
             auto now = clock::now();
+            if (shouldStop.load()) {
+                break;
+            }
             if (std::chrono::duration<double>(now - start).count() >
                 timeLimit) {
                 shouldStop.store(true);
@@ -980,18 +1108,28 @@ inline Callback iterative_deepening(const Board &brd, int ep, bool WH, bool EP,
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
     });
-    int bestFrom = 255;
-    int bestTo = 255;
+    if (KEEP_HEURISTICS) {
+        ageHistoryTable(HISTORY_MOVE_AGE_FACTOR);
+    } else {
+        clearHeuristics();
+    }
+    RootMoves root(brd, ep, WH, EP, WL, WR, BL, BR);
+    repetitions.seed(gameHistory.data(), (int)gameHistory.size(),
+                     irreversibleCount, root.key);
 
     for (int depth = 1; depth <= max_depth; depth += 1) {
-        // clearHistoryTable();
-        ageHistoryTable();
+        ageHistoryTable(HISTORY_AGE_FACTOR);
         if (shouldStop.load()) {
             break;
         }
-        bestMove =
-            findBestMove(brd, ep, WH, EP, WL, WR, BL, BR, depth,
-                         irreversibleCount, eval, bestFrom, bestTo, stats);
+        const int best = findBestMove(brd, root, WH, EP, WL, WR, BL, BR,
+                                      depth, irreversibleCount, eval, stats);
+        if (best != -1) {
+            bestMove = root.moves[best].move;
+            if (!shouldStop.load()) {
+                root.reorder(best);
+            }
+        }
         if (0 <= MAX_SEARCH_DEPTH && pvLength[0] > 0) {
             previousPvLineLength = pvLength[0];
             memcpy(previousPvLine, &pvTable[0][0],
@@ -1000,7 +1138,8 @@ inline Callback iterative_deepening(const Board &brd, int ep, bool WH, bool EP,
             previousPvLineLength = 0;
         }
     }
-    clearHistoryTable();
+    // Ends the timer when max_depth was reached first.
+    shouldStop.store(true);
     timerThread.join();
     return bestMove;
 }
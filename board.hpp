@@ -43,11 +43,28 @@ struct Move {
 
 typedef struct Move Move;
 
+// Search state template modes, picked at build time (cmake -DSTATE=...):
+//   STATE_FULL  side to move, en passant and all four castling rights are
+//               template parameters (64 instantiations of everything)
+//   STATE_SIDE  only the side to move is; en passant is taken from the ep
+//               square and castling from the mailbox flags at runtime
+#if !defined(STATE_FULL) && !defined(STATE_SIDE)
+#define STATE_SIDE
+#endif
+
 struct BoardState {
     const bool IsWhite, EP, WLC, WRC, BLC, BRC;
+#if defined(STATE_SIDE)
+    // Every state folds into "anything allowed" for its side, so the
+    // transitions below and every dispatch tree land on two instantiations.
+    constexpr BoardState(bool IsWhite, bool, bool, bool, bool, bool)
+        : IsWhite(IsWhite), EP(true), WLC(true), WRC(true), BLC(true),
+          BRC(true) {}
+#else
     constexpr BoardState(bool IsWhite, bool EP, bool WLC, bool WRC, bool BLC,
                          bool BRC)
         : IsWhite(IsWhite), EP(EP), WLC(WLC), WRC(WRC), BLC(BLC), BRC(BRC) {}
+#endif
     constexpr BoardState()
         : IsWhite(0), EP(0), WLC(0), WRC(0), BLC(0), BRC(0) {}
 
@@ -84,9 +101,54 @@ struct BoardState {
     }
 };
 
+#include <array>
 #include <math.h>
+
+// Board layout, picked at build time (cmake -DBOARD=...):
+//   BOARD_PLAIN   the piece bitboards are plain fields, moves update them
+//                 one by one
+//   BOARD_PACKED  the twelve piece bitboards sit in three aligned 4 lane
+//                 vectors and moves update them with AVX2, see packedMove
+#if !defined(BOARD_PLAIN) && !defined(BOARD_PACKED)
+#define BOARD_PLAIN
+#endif
+#if defined(BOARD_PACKED)
+#if !defined(__AVX2__)
+#error "BOARD_PACKED needs an AVX2 target (-mavx2)"
+#endif
+#include <immintrin.h>
+#define PACKED_ALIGN alignas(32)
+#else
+#define PACKED_ALIGN
+#endif
+
+// Mailbox square codes: the BoardPiece value, plus 8 for white pieces.
+constexpr uint8_t NO_PIECE = 6;
+// Set on the king and rook home squares while castling that way is allowed.
+// Any move from or onto the square rewrites the code and drops the flag.
+constexpr uint8_t CASTLE_FLAG = 16;
+
+constexpr uint8_t pieceCode(BoardPiece piece, bool white) noexcept {
+    return (uint8_t)piece | (white ? 8 : 0);
+}
+
+using Mailbox = std::array<uint8_t, 64>;
+
+constexpr Mailbox buildMailbox(const uint64_t (&pieces)[12]) noexcept {
+    Mailbox mailbox{};
+    for (int sq = 0; sq < 64; sq++) {
+        mailbox[sq] = NO_PIECE;
+        for (int i = 0; i < 12; i++) {
+            if (pieces[i] & (1ULL << sq)) {
+                mailbox[sq] = pieceCode(BoardPiece(i % 6), i >= 6);
+            }
+        }
+    }
+    return mailbox;
+}
+
 struct Board {
-    const uint64_t BPawn;
+    PACKED_ALIGN const uint64_t BPawn;
     const uint64_t BKnight;
     const uint64_t BBishop;
     const uint64_t BRook;
@@ -103,21 +165,128 @@ struct Board {
     const uint64_t White;
     const uint64_t Occ;
 
+    // Piece on every square, kept in step with the bitboards by the move
+    // constructors below so piece lookups are a single load.
+    const Mailbox mailbox;
+
     constexpr Board(uint64_t bp, uint64_t bn, uint64_t bb, uint64_t br,
                     uint64_t bq, uint64_t bk, uint64_t wp, uint64_t wn,
                     uint64_t wb, uint64_t wr, uint64_t wq, uint64_t wk) noexcept
+        : Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk,
+                buildMailbox(
+                    {bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk})) {}
+    constexpr Board(uint64_t bp, uint64_t bn, uint64_t bb, uint64_t br,
+                    uint64_t bq, uint64_t bk, uint64_t wp, uint64_t wn,
+                    uint64_t wb, uint64_t wr, uint64_t wq, uint64_t wk,
+                    const Mailbox &mb) noexcept
         : BPawn(bp), BKnight(bn), BBishop(bb), BRook(br), BQueen(bq), BKing(bk),
           WPawn(wp), WKnight(wn), WBishop(wb), WRook(wr), WQueen(wq), WKing(wk),
           Black(bp | bn | bb | br | bq | bk),
-          White(wp | wn | wb | wr | wq | wk), Occ(Black | White) {}
+          White(wp | wn | wb | wr | wq | wk), Occ(Black | White), mailbox(mb) {}
+#if defined(BOARD_PACKED)
+    // From the twelve piece bitboards in field order and their unions.
+    Board(const uint64_t (&pieces)[12], uint64_t black, uint64_t white,
+          const Mailbox &mb) noexcept
+        : BPawn(pieces[0]), BKnight(pieces[1]), BBishop(pieces[2]),
+          BRook(pieces[3]), BQueen(pieces[4]), BKing(pieces[5]),
+          WPawn(pieces[6]), WKnight(pieces[7]), WBishop(pieces[8]),
+          WRook(pieces[9]), WQueen(pieces[10]), WKing(pieces[11]),
+          Black(black), White(white), Occ(black | white), mailbox(mb) {}
+#endif
     constexpr Board() noexcept
         : BPawn(0), BKnight(0), BBishop(0), BRook(0), BQueen(0), BKing(0),
           WPawn(0), WKnight(0), WBishop(0), WRook(0), WQueen(0), WKing(0),
-          Black(0), White(0), Occ(0) {}
+          Black(0), White(0), Occ(0), mailbox(buildMailbox({})) {}
+
+    // Piece type (BoardPiece value) on sq, NO_PIECE when empty.
+    constexpr int pieceOn(int sq) const noexcept { return mailbox[sq] & 7; }
+
+    constexpr bool whiteOn(int sq) const noexcept { return mailbox[sq] & 8; }
+
+    // Castling with the king on kingSq and the rook on rookSq is still
+    // allowed. The template state alone misses a rook captured at home and
+    // replaced by another one.
+    constexpr bool canCastle(int kingSq, int rookSq) const noexcept {
+        return mailbox[kingSq] & mailbox[rookSq] & CASTLE_FLAG;
+    }
+
+    // WLC | WRC << 1 | BLC << 2 | BRC << 3 from the mailbox flags.
+    constexpr int castlingRights() const noexcept {
+        return (mailbox[4] & mailbox[0] & CASTLE_FLAG ? 1 : 0) |
+               (mailbox[4] & mailbox[7] & CASTLE_FLAG ? 2 : 0) |
+               (mailbox[60] & mailbox[56] & CASTLE_FLAG ? 4 : 0) |
+               (mailbox[60] & mailbox[63] & CASTLE_FLAG ? 8 : 0);
+    }
+
+#if defined(BOARD_PACKED)
+    // OR of the four lanes of v.
+    static uint64_t packedUnion(__m256i v) noexcept {
+        v = _mm256_or_si256(v, _mm256_permute4x64_epi64(v, 0x4E));
+        v = _mm256_or_si256(v, _mm256_shuffle_epi32(v, 0x4E));
+        return _mm_cvtsi128_si64(_mm256_castsi256_si128(v));
+    }
+
+    // Every move but castling as one pass over the three piece vectors:
+    // `from` is toggled in lane fromLane, `to` in lane toLane and `clear`
+    // is removed from the lanes in [clearLo, clearHi). Lanes are the field
+    // order, BoardPiece plus 6 for white. The lane selectors are constants,
+    // so each vector costs an andnot and two xors plus the broadcasts.
+    template <int fromLane, int toLane, int clearLo, int clearHi>
+    Board packedMove(uint64_t from, uint64_t to, uint64_t clear,
+                     const Mailbox &mb) const noexcept {
+        const __m256i *src = (const __m256i *)&BPawn;
+        alignas(32) uint64_t pieces[12];
+        __m256i v[3];
+        for (int i = 0; i < 3; i++) {
+            const __m256i lane =
+                _mm256_setr_epi64x(4 * i, 4 * i + 1, 4 * i + 2, 4 * i + 3);
+            const __m256i fromSel =
+                _mm256_cmpeq_epi64(lane, _mm256_set1_epi64x(fromLane));
+            const __m256i toSel =
+                _mm256_cmpeq_epi64(lane, _mm256_set1_epi64x(toLane));
+            const __m256i clearSel = _mm256_and_si256(
+                _mm256_cmpgt_epi64(lane, _mm256_set1_epi64x(clearLo - 1)),
+                _mm256_cmpgt_epi64(_mm256_set1_epi64x(clearHi), lane));
+            __m256i x = _mm256_load_si256(src + i);
+            x = _mm256_andnot_si256(
+                _mm256_and_si256(clearSel, _mm256_set1_epi64x(clear)), x);
+            x = _mm256_xor_si256(
+                x, _mm256_and_si256(fromSel, _mm256_set1_epi64x(from)));
+            x = _mm256_xor_si256(
+                x, _mm256_and_si256(toSel, _mm256_set1_epi64x(to)));
+            _mm256_store_si256((__m256i *)pieces + i, x);
+            v[i] = x;
+        }
+        // Black is lanes 0-5, white 6-11.
+        const __m256i low = _mm256_setr_epi64x(-1, -1, 0, 0);
+        const uint64_t black =
+            packedUnion(_mm256_or_si256(v[0], _mm256_and_si256(v[1], low)));
+        const uint64_t white = packedUnion(
+            _mm256_or_si256(v[2], _mm256_andnot_si256(low, v[1])));
+        return Board(pieces, black, white, mb);
+    }
+
+    // First lane of the side's pieces.
+    static constexpr int lane(bool white) noexcept { return white ? 6 : 0; }
+#endif
+
+    template <BoardPiece piece, bool IsWhite>
+    _fast Mailbox mailboxMove(int moveFrom, int moveTo) const noexcept {
+        Mailbox mb = mailbox;
+        mb[moveFrom] = NO_PIECE;
+        mb[moveTo] = pieceCode(piece, IsWhite);
+        return mb;
+    }
 
     template <BoardPiece piece, bool IsWhite, bool WLC, bool WRC, bool BLC,
               bool BRC>
     _fast Board move(int moveFrom, int moveTo) const noexcept {
+#if defined(BOARD_PACKED)
+        constexpr int mover = lane(IsWhite) + (int)piece;
+        return packedMove<mover, mover, 0, 0>(
+            1ULL << moveFrom, 1ULL << moveTo, 0,
+            mailboxMove<piece, IsWhite>(moveFrom, moveTo));
+#else
         const uint64_t bp = BPawn;
         const uint64_t bn = BKnight;
         const uint64_t bb = BBishop;
@@ -130,50 +299,59 @@ struct Board {
         const uint64_t wr = WRook;
         const uint64_t wq = WQueen;
         const uint64_t wk = WKing;
+        const Mailbox mb = mailboxMove<piece, IsWhite>(moveFrom, moveTo);
         const uint64_t mov = 1ULL << moveTo | 1ULL << moveFrom;
         if constexpr (IsWhite) {
             if constexpr (BoardPiece::Pawn == piece)
                 return Board(bp, bn, bb, br, bq, bk, wp ^ mov, wn, wb, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Knight == piece)
                 return Board(bp, bn, bb, br, bq, bk, wp, wn ^ mov, wb, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Bishop == piece)
                 return Board(bp, bn, bb, br, bq, bk, wp, wn, wb ^ mov, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Rook == piece)
                 return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr ^ mov, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Queen == piece)
                 return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq ^ mov,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::King == piece)
                 return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq,
-                             wk ^ mov);
+                             wk ^ mov, mb);
         } else {
             if constexpr (BoardPiece::Pawn == piece)
                 return Board(bp ^ mov, bn, bb, br, bq, bk, wp, wn, wb, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Knight == piece)
                 return Board(bp, bn ^ mov, bb, br, bq, bk, wp, wn, wb, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Bishop == piece)
                 return Board(bp, bn, bb ^ mov, br, bq, bk, wp, wn, wb, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Rook == piece)
                 return Board(bp, bn, bb, br ^ mov, bq, bk, wp, wn, wb, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::Queen == piece)
                 return Board(bp, bn, bb, br, bq ^ mov, bk, wp, wn, wb, wr, wq,
-                             wk);
+                             wk, mb);
             if constexpr (BoardPiece::King == piece)
                 return Board(bp, bn, bb, br, bq, bk ^ mov, wp, wn, wb, wr, wq,
-                             wk);
+                             wk, mb);
         }
+#endif
     }
     template <BoardPiece piece, bool IsWhite, bool WLC, bool WRC, bool BLC,
               bool BRC>
     _fast Board capture(int moveFrom, int moveTo) const noexcept {
+#if defined(BOARD_PACKED)
+        constexpr int mover = lane(IsWhite) + (int)piece;
+        constexpr int enemy = lane(!IsWhite);
+        return packedMove<mover, mover, enemy, enemy + 5>(
+            1ULL << moveFrom, 1ULL << moveTo, 1ULL << moveTo,
+            mailboxMove<piece, IsWhite>(moveFrom, moveTo));
+#else
         const uint64_t bp = BPawn;
         const uint64_t bn = BKnight;
         const uint64_t bb = BBishop;
@@ -186,47 +364,49 @@ struct Board {
         const uint64_t wr = WRook;
         const uint64_t wq = WQueen;
         const uint64_t wk = WKing;
+        const Mailbox mb = mailboxMove<piece, IsWhite>(moveFrom, moveTo);
         const uint64_t mov = 1ULL << moveTo | 1ULL << moveFrom;
         const uint64_t rem = ~(1ULL << moveTo);
         if constexpr (IsWhite) {
             if constexpr (BoardPiece::Pawn == piece)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp ^ mov, wn, wb, wr, wq, wk);
+                             bk, wp ^ mov, wn, wb, wr, wq, wk, mb);
             if constexpr (BoardPiece::Knight == piece)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp, wn ^ mov, wb, wr, wq, wk);
+                             bk, wp, wn ^ mov, wb, wr, wq, wk, mb);
             if constexpr (BoardPiece::Bishop == piece)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp, wn, wb ^ mov, wr, wq, wk);
+                             bk, wp, wn, wb ^ mov, wr, wq, wk, mb);
             if constexpr (BoardPiece::Rook == piece)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp, wn, wb, wr ^ mov, wq, wk);
+                             bk, wp, wn, wb, wr ^ mov, wq, wk, mb);
             if constexpr (BoardPiece::Queen == piece)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp, wn, wb, wr, wq ^ mov, wk);
+                             bk, wp, wn, wb, wr, wq ^ mov, wk, mb);
             if constexpr (BoardPiece::King == piece)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp, wn, wb, wr, wq, wk ^ mov);
+                             bk, wp, wn, wb, wr, wq, wk ^ mov, mb);
         } else {
             if constexpr (BoardPiece::Pawn == piece)
                 return Board(bp ^ mov, bn, bb, br, bq, bk, wp & rem, wn & rem,
-                             wb & rem, wr & rem, wq & rem, wk);
+                             wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (BoardPiece::Knight == piece)
                 return Board(bp, bn ^ mov, bb, br, bq, bk, wp & rem, wn & rem,
-                             wb & rem, wr & rem, wq & rem, wk);
+                             wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (BoardPiece::Bishop == piece)
                 return Board(bp, bn, bb ^ mov, br, bq, bk, wp & rem, wn & rem,
-                             wb & rem, wr & rem, wq & rem, wk);
+                             wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (BoardPiece::Rook == piece)
                 return Board(bp, bn, bb, br ^ mov, bq, bk, wp & rem, wn & rem,
-                             wb & rem, wr & rem, wq & rem, wk);
+                             wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (BoardPiece::Queen == piece)
                 return Board(bp, bn, bb, br, bq ^ mov, bk, wp & rem, wn & rem,
-                             wb & rem, wr & rem, wq & rem, wk);
+                             wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (BoardPiece::King == piece)
                 return Board(bp, bn, bb, br, bq, bk ^ mov, wp & rem, wn & rem,
-                             wb & rem, wr & rem, wq & rem, wk);
+                             wb & rem, wr & rem, wq & rem, wk, mb);
         }
+#endif
     }
 
     template <BoardPiece piece, bool IsWhite, bool WLC, bool WRC, bool BLC,
@@ -244,23 +424,38 @@ struct Board {
         const uint64_t wr = WRook;
         const uint64_t wq = WQueen;
         const uint64_t wk = WKing;
+        Mailbox mb = mailboxMove<BoardPiece::Pawn, IsWhite>(moveFrom, moveTo);
+        mb[IsWhite ? moveTo - 8 : moveTo + 8] = NO_PIECE;
+#if defined(BOARD_PACKED)
+        constexpr int mover = lane(IsWhite);
+        constexpr int enemy = lane(!IsWhite);
+        return packedMove<mover, mover, enemy, enemy + 1>(
+            1ULL << moveFrom, 1ULL << moveTo,
+            1ULL << (IsWhite ? moveTo - 8 : moveTo + 8), mb);
+#else
         const uint64_t from = 1ULL << moveFrom;
         const uint64_t to = 1ULL << moveTo;
         const uint64_t mov = from | to;
         if constexpr (IsWhite) {
             const uint64_t remove = 1ULL << (moveTo - 8);
             return Board(bp ^ remove, bn, bb, br, bq, bk, wp ^ mov, wn, wb, wr,
-                         wq, wk);
+                         wq, wk, mb);
         } else {
             const uint64_t remove = 1ULL << (moveTo + 8);
             return Board(bp ^ mov, bn, bb, br, bq, bk, wp ^ remove, wn, wb, wr,
-                         wq, wk);
+                         wq, wk, mb);
         }
+#endif
     }
 
     template <BoardPiece piece, bool IsWhite, bool WLC, bool WRC, bool BLC,
               bool BRC>
     _fast Board promote(int moveFrom, int moveTo) const noexcept {
+#if defined(BOARD_PACKED)
+        return packedMove<lane(IsWhite), lane(IsWhite) + (int)piece, 0, 0>(
+            1ULL << moveFrom, 1ULL << moveTo, 0,
+            mailboxMove<piece, IsWhite>(moveFrom, moveTo));
+#else
         const uint64_t bp = BPawn;
         const uint64_t bn = BKnight;
         const uint64_t bb = BBishop;
@@ -273,39 +468,48 @@ struct Board {
         const uint64_t wr = WRook;
         const uint64_t wq = WQueen;
         const uint64_t wk = WKing;
+        const Mailbox mb = mailboxMove<piece, IsWhite>(moveFrom, moveTo);
         const uint64_t from = 1ULL << moveFrom;
         const uint64_t to = 1ULL << moveTo;
         if constexpr (IsWhite) {
             if constexpr (piece == BoardPiece::Queen)
                 return Board(bp, bn, bb, br, bq, bk, wp ^ from, wn, wb, wr,
-                             wq ^ to, wk);
+                             wq ^ to, wk, mb);
             if constexpr (piece == BoardPiece::Rook)
                 return Board(bp, bn, bb, br, bq, bk, wp ^ from, wn, wb, wr ^ to,
-                             wq, wk);
+                             wq, wk, mb);
             if constexpr (piece == BoardPiece::Bishop)
                 return Board(bp, bn, bb, br, bq, bk, wp ^ from, wn, wb ^ to, wr,
-                             wq, wk);
+                             wq, wk, mb);
             if constexpr (piece == BoardPiece::Knight)
                 return Board(bp, bn, bb, br, bq, bk, wp ^ from, wn ^ to, wb, wr,
-                             wq, wk);
+                             wq, wk, mb);
         } else {
             if constexpr (piece == BoardPiece::Queen)
                 return Board(bp ^ from, bn, bb, br, bq ^ to, bk, wp, wn, wb, wr,
-                             wq, wk);
+                             wq, wk, mb);
             if constexpr (piece == BoardPiece::Rook)
                 return Board(bp ^ from, bn, bb, br ^ to, bq, bk, wp, wn, wb, wr,
-                             wq, wk);
+                             wq, wk, mb);
             if constexpr (piece == BoardPiece::Bishop)
                 return Board(bp ^ from, bn, bb ^ to, br, bq, bk, wp, wn, wb, wr,
-                             wq, wk);
+                             wq, wk, mb);
             if constexpr (piece == BoardPiece::Knight)
                 return Board(bp ^ from, bn ^ to, bb, br, bq, bk, wp, wn, wb, wr,
-                             wq, wk);
+                             wq, wk, mb);
         }
+#endif
     }
     template <BoardPiece piece, bool IsWhite, bool WLC, bool WRC, bool BLC,
               bool BRC>
     _fast Board promoteCapture(int moveFrom, int moveTo) const noexcept {
+#if defined(BOARD_PACKED)
+        constexpr int enemy = lane(!IsWhite);
+        return packedMove<lane(IsWhite), lane(IsWhite) + (int)piece, enemy,
+                          enemy + 5>(
+            1ULL << moveFrom, 1ULL << moveTo, 1ULL << moveTo,
+            mailboxMove<piece, IsWhite>(moveFrom, moveTo));
+#else
         const uint64_t bp = BPawn;
         const uint64_t bn = BKnight;
         const uint64_t bb = BBishop;
@@ -318,36 +522,38 @@ struct Board {
         const uint64_t wr = WRook;
         const uint64_t wq = WQueen;
         const uint64_t wk = WKing;
+        const Mailbox mb = mailboxMove<piece, IsWhite>(moveFrom, moveTo);
         const uint64_t from = 1ULL << moveFrom;
         const uint64_t to = 1ULL << moveTo;
         const uint64_t rem = ~(1ULL << moveTo);
         if constexpr (IsWhite) {
             if constexpr (piece == BoardPiece::Queen)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp ^ from, wn, wb, wr, wq ^ to, wk);
+                             bk, wp ^ from, wn, wb, wr, wq ^ to, wk, mb);
             if constexpr (piece == BoardPiece::Rook)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp ^ from, wn, wb, wr ^ to, wq, wk);
+                             bk, wp ^ from, wn, wb, wr ^ to, wq, wk, mb);
             if constexpr (piece == BoardPiece::Bishop)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp ^ from, wn, wb ^ to, wr, wq, wk);
+                             bk, wp ^ from, wn, wb ^ to, wr, wq, wk, mb);
             if constexpr (piece == BoardPiece::Knight)
                 return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem,
-                             bk, wp ^ from, wn ^ to, wb, wr, wq, wk);
+                             bk, wp ^ from, wn ^ to, wb, wr, wq, wk, mb);
         } else {
             if constexpr (piece == BoardPiece::Queen)
                 return Board(bp ^ from, bn, bb, br, bq ^ to, bk, wp & rem,
-                             wn & rem, wb & rem, wr & rem, wq & rem, wk);
+                             wn & rem, wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (piece == BoardPiece::Rook)
                 return Board(bp ^ from, bn, bb, br ^ to, bq, bk, wp & rem,
-                             wn & rem, wb & rem, wr & rem, wq & rem, wk);
+                             wn & rem, wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (piece == BoardPiece::Bishop)
                 return Board(bp ^ from, bn, bb ^ to, br, bq, bk, wp & rem,
-                             wn & rem, wb & rem, wr & rem, wq & rem, wk);
+                             wn & rem, wb & rem, wr & rem, wq & rem, wk, mb);
             if constexpr (piece == BoardPiece::Knight)
                 return Board(bp ^ from, bn ^ to, bb, br, bq, bk, wp & rem,
-                             wn & rem, wb & rem, wr & rem, wq & rem, wk);
+                             wn & rem, wb & rem, wr & rem, wq & rem, wk, mb);
         }
+#endif
     }
     template <BoardPiece piece, bool IsWhite, bool WLC, bool WRC, bool BLC,
               bool BRC>
@@ -366,20 +572,36 @@ struct Board {
         const uint64_t wk = WKing;
 
         if constexpr (WLC) {
+            Mailbox mb = mailbox;
+            mb[4] = mb[0] = NO_PIECE;
+            mb[2] = pieceCode(BoardPiece::King, true);
+            mb[3] = pieceCode(BoardPiece::Rook, true);
             return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr ^ WRookLChange,
-                         wq, wk ^ WKingLChange);
+                         wq, wk ^ WKingLChange, mb);
         }
         if constexpr (WRC) {
+            Mailbox mb = mailbox;
+            mb[4] = mb[7] = NO_PIECE;
+            mb[6] = pieceCode(BoardPiece::King, true);
+            mb[5] = pieceCode(BoardPiece::Rook, true);
             return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr ^ WRookRChange,
-                         wq, wk ^ WKingRChange);
+                         wq, wk ^ WKingRChange, mb);
         }
         if constexpr (BLC) {
+            Mailbox mb = mailbox;
+            mb[60] = mb[56] = NO_PIECE;
+            mb[58] = pieceCode(BoardPiece::King, false);
+            mb[59] = pieceCode(BoardPiece::Rook, false);
             return Board(bp, bn, bb, br ^ BRookLChange, bq, bk ^ BKingLChange,
-                         wp, wn, wb, wr, wq, wk);
+                         wp, wn, wb, wr, wq, wk, mb);
         }
         if constexpr (BRC) {
+            Mailbox mb = mailbox;
+            mb[60] = mb[63] = NO_PIECE;
+            mb[62] = pieceCode(BoardPiece::King, false);
+            mb[61] = pieceCode(BoardPiece::Rook, false);
             return Board(bp, bn, bb, br ^ BRookRChange, bq, bk ^ BKingRChange,
-                         wp, wn, wb, wr, wq, wk);
+                         wp, wn, wb, wr, wq, wk, mb);
         }
     }
 };
@@ -467,7 +689,7 @@ inline constexpr int parseEnPassantSquare(const char *FEN) {
     }
     char file = FEN[space3 + 1];
     char rank = FEN[space3 + 2];
-    return (7 - (file - 'a')) + 8 * (rank - '1');
+    return (file - 'a') + 8 * (rank - '1');
 }
 
 inline constexpr BoardState parseBoardState(const char *fenCStr) {
@@ -502,8 +724,32 @@ inline constexpr BoardState parseBoardState(const char *fenCStr) {
 }
 
 inline Board loadFenBoard(std::string FEN) {
-    return Board(FenToBmp(FEN, 'p'), FenToBmp(FEN, 'n'), FenToBmp(FEN, 'b'),
-                 FenToBmp(FEN, 'r'), FenToBmp(FEN, 'q'), FenToBmp(FEN, 'k'),
-                 FenToBmp(FEN, 'P'), FenToBmp(FEN, 'N'), FenToBmp(FEN, 'B'),
-                 FenToBmp(FEN, 'R'), FenToBmp(FEN, 'Q'), FenToBmp(FEN, 'K'));
+    const Board brd(FenToBmp(FEN, 'p'), FenToBmp(FEN, 'n'), FenToBmp(FEN, 'b'),
+                    FenToBmp(FEN, 'r'), FenToBmp(FEN, 'q'), FenToBmp(FEN, 'k'),
+                    FenToBmp(FEN, 'P'), FenToBmp(FEN, 'N'), FenToBmp(FEN, 'B'),
+                    FenToBmp(FEN, 'R'), FenToBmp(FEN, 'Q'), FenToBmp(FEN, 'K'));
+
+    // Flag the king and rook of every castling right in the third field.
+    Mailbox mb = brd.mailbox;
+    size_t field = FEN.find(' ');
+    field = field == std::string::npos ? field : FEN.find(' ', field + 1);
+    for (size_t i = field + 1; field != std::string::npos && i < FEN.size() &&
+                               FEN[i] != ' ';
+         i++) {
+        const size_t right = std::string("QKqk").find(FEN[i]);
+        if (right == std::string::npos) {
+            continue;
+        }
+        const bool white = right < 2;
+        const int kingSq = white ? 4 : 60;
+        const int rookSq = (white ? 0 : 56) + (right & 1 ? 7 : 0);
+        if ((mb[kingSq] & ~CASTLE_FLAG) == pieceCode(BoardPiece::King, white) &&
+            (mb[rookSq] & ~CASTLE_FLAG) == pieceCode(BoardPiece::Rook, white)) {
+            mb[kingSq] |= CASTLE_FLAG;
+            mb[rookSq] |= CASTLE_FLAG;
+        }
+    }
+    return Board(brd.BPawn, brd.BKnight, brd.BBishop, brd.BRook, brd.BQueen,
+                 brd.BKing, brd.WPawn, brd.WKnight, brd.WBishop, brd.WRook,
+                 brd.WQueen, brd.WKing, mb);
 }
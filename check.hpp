@@ -1,35 +1,40 @@
 #pragma once
 #include "board.hpp"
 #include "constants.hpp"
+#include "move.hpp"
 #include "pawns.hpp"
 #include "sliding.hpp"
 #include <cassert>
 #include <cstdint>
 template <bool IsWhite>
-_fast static void pawnCheckmask(const Board &brd,
-                                uint64_t &checkmask) noexcept {
+_fast static void pawnCheckmask(const Board &brd, uint64_t &checkmask,
+                                uint64_t &checkers) noexcept {
     if constexpr (IsWhite) {
         const uint64_t left = ((brd.WKing << 7) & (~File1)) & brd.BPawn;
         const uint64_t right = ((brd.WKing << 9) & (~File8)) & brd.BPawn;
         checkmask &=
             ((!(static_cast<bool>(left | right)) * ONES) | (left | right));
+        checkers |= left | right;
     } else {
         const uint64_t left = ((brd.BKing >> 9) & (~File1)) & brd.WPawn;
         const uint64_t right = ((brd.BKing >> 7) & (~File8)) & brd.WPawn;
         checkmask &=
             (((!static_cast<bool>(left | right)) * ONES) | (left | right));
+        checkers |= left | right;
     }
 }
 
 template <bool IsWhite>
 _fast static void knightCheckmask(const Board &brd, uint64_t &checkmask,
-                                  int kingPos) noexcept {
+                                  uint64_t &checkers, int kingPos) noexcept {
     if constexpr (IsWhite) {
         const uint64_t knight = knightMasks[kingPos] & brd.BKnight;
         checkmask &= (!static_cast<bool>(knight)) * ONES | knight;
+        checkers |= knight;
     } else {
         const uint64_t knight = knightMasks[kingPos] & brd.WKnight;
         checkmask &= (!static_cast<bool>(knight)) * ONES | knight;
+        checkers |= knight;
     }
 }
 
@@ -42,6 +47,7 @@ inline int flipX(int sq) noexcept {
 template <bool IsWhite>
 _fast static void slidingPieceCheckmask(const Board &brd, uint64_t &pinHV,
                                         uint64_t &pinD, uint64_t &checkmask,
+                                        uint64_t &checkers,
                                         int kingPos) noexcept {
     if constexpr (IsWhite) {
         uint64_t sliding = 0;
@@ -66,6 +72,7 @@ _fast static void slidingPieceCheckmask(const Board &brd, uint64_t &pinHV,
                 pinD |= kingPath[64 * kingPos + skewerPos];
             }
         }
+        checkers |= sliding;
         const int slidingCount = __builtin_popcountll(sliding);
         if (slidingCount >= 2) {
             checkmask = 0;
@@ -97,6 +104,7 @@ _fast static void slidingPieceCheckmask(const Board &brd, uint64_t &pinHV,
                 pinD |= kingPath[64 * kingPos + skewerPos];
             }
         }
+        checkers |= sliding;
         const int slidingCount = __builtin_popcountll(sliding);
         if (slidingCount >= 2) {
             checkmask = 0;
@@ -140,12 +148,131 @@ _fast void generateKingBan(const Board &brd, uint64_t &kingBan) noexcept {
     Bitloop(rooks) { kingBan |= getRmagic(__builtin_ctzll(rooks), brd.Occ^kingMask); }
 }
 
+// Check and pin state of the side to move. Computed once per node and
+// handed to move generation, check detection and SEE instead of each of
+// them redoing the slider lookups.
+struct AttackInfo {
+    uint64_t kingBan = 0; // enemy attacks, seen through our own king
+    uint64_t checkers = 0;
+    uint64_t checkmask = ONES; // targets that resolve a single check
+    uint64_t pinHV = 0;
+    uint64_t pinD = 0;
+
+    constexpr bool inCheck() const noexcept { return checkers != 0; }
+};
+
+template <bool IsWhite>
+_fast AttackInfo generateCheck(const Board &brd) noexcept {
+    AttackInfo info;
+    const int kingPos = __builtin_ctzll(IsWhite ? brd.WKing : brd.BKing);
+    slidingPieceCheckmask<IsWhite>(brd, info.pinHV, info.pinD, info.checkmask,
+                                   info.checkers, kingPos);
+    pawnCheckmask<IsWhite>(brd, info.checkmask, info.checkers);
+    knightCheckmask<IsWhite>(brd, info.checkmask, info.checkers, kingPos);
+    generateKingBan<IsWhite>(brd, info.kingBan);
+    return info;
+}
+
+// What the side to move needs to give check: the squares each piece type
+// checks the enemy king from (indexed by BoardPiece, the king's stays
+// empty), and the own pieces that uncover a slider check by leaving the
+// line to the king.
+struct CheckSquares {
+    uint64_t squares[6] = {};
+    uint64_t discoverers = 0;
+    int kingPos = 0;
+};
+
+template <bool IsWhite>
+_fast CheckSquares generateCheckSquares(const Board &brd) noexcept {
+    CheckSquares cs;
+    const uint64_t king = IsWhite ? brd.BKing : brd.WKing;
+    const uint64_t own = IsWhite ? brd.White : brd.Black;
+    const uint64_t queens = IsWhite ? brd.WQueen : brd.BQueen;
+    const uint64_t diagonal = (IsWhite ? brd.WBishop : brd.BBishop) | queens;
+    const uint64_t orthogonal = (IsWhite ? brd.WRook : brd.BRook) | queens;
+    const int kingPos = __builtin_ctzll(king);
+    cs.kingPos = kingPos;
+    // A pawn checks from where an enemy pawn on the king square captures.
+    cs.squares[0] = pawnCouldAttackLeft<!IsWhite>(king) |
+                    pawnCouldAttackRight<!IsWhite>(king);
+    cs.squares[1] = knightMasks[kingPos];
+    cs.squares[2] = getBmagic(kingPos, brd.Occ);
+    cs.squares[3] = getRmagic(kingPos, brd.Occ);
+    cs.squares[4] = cs.squares[2] | cs.squares[3];
+
+    uint64_t xRay = 0;
+    if (RookMask[kingPos] & orthogonal) {
+        xRay |= getRmagic(kingPos, brd.Occ ^ (cs.squares[3] & own)) &
+                orthogonal;
+    }
+    if (BishopMask[kingPos] & diagonal) {
+        xRay |= getBmagic(kingPos, brd.Occ ^ (cs.squares[2] & own)) &
+                diagonal;
+    }
+    Bitloop(xRay) {
+        const int xRayPos = __builtin_ctzll(xRay);
+        cs.discoverers |=
+            kingPath[64 * kingPos + xRayPos] & own & ~(1ULL << xRayPos);
+    }
+    return cs;
+}
+
+// Own sliders, except those in `gone`, attacking the enemy king on occ.
+template <bool IsWhite>
+_fast bool sliderChecks(const Board &brd, int kingPos, uint64_t occ,
+                        uint64_t gone) noexcept {
+    const uint64_t queens = IsWhite ? brd.WQueen : brd.BQueen;
+    const uint64_t diagonal = (IsWhite ? brd.WBishop : brd.BBishop) | queens;
+    const uint64_t orthogonal = (IsWhite ? brd.WRook : brd.BRook) | queens;
+    return (getBmagic(kingPos, occ) & diagonal & ~gone) |
+           (getRmagic(kingPos, occ) & orthogonal & ~gone);
+}
+
+// Whether the side to move checks the enemy king by playing move on brd,
+// without making it. Plain moves are a lookup and an AND, plus an
+// occupancy test when a discoverer moves; promotions, en passant and
+// castling change more than one square and are tested on the new
+// occupancy.
 template <bool IsWhite>
-_fast void generateCheck(const Board &brd, int kingPos, uint64_t &pinHV,
-                         uint64_t &pinD, uint64_t &checkmask,
-                         uint64_t &kingBan) noexcept {
-    slidingPieceCheckmask<IsWhite>(brd, pinHV, pinD, checkmask, kingPos);
-    pawnCheckmask<IsWhite>(brd, checkmask);
-    knightCheckmask<IsWhite>(brd, checkmask, kingPos);
-    generateKingBan<IsWhite>(brd, kingBan);
+_fast bool givesCheck(const Board &brd, const CheckSquares &cs,
+                      EncodedMove move) noexcept {
+    const int from = moveFrom(move);
+    const int to = moveTo(move);
+    const uint64_t fromBB = 1ULL << from;
+    const uint64_t toBB = 1ULL << to;
+    const int kingPos = cs.kingPos;
+    const MoveKind kind = moveKind(move);
+    uint64_t occ = (brd.Occ ^ fromBB) | toBB;
+    if (kind == MoveKind::Quiet || kind == MoveKind::DoublePush ||
+        kind == MoveKind::Capture) {
+        return (cs.squares[brd.pieceOn(from)] & toBB) ||
+               ((cs.discoverers & fromBB) &&
+                sliderChecks<IsWhite>(brd, kingPos, occ, fromBB));
+    }
+    if (isPromotion(move)) {
+        const BoardPiece piece = promotionPieces[movePromotion(move)];
+        uint64_t direct = 0;
+        if (piece == BoardPiece::Knight) {
+            direct = knightMasks[kingPos];
+        }
+        if (piece == BoardPiece::Queen || piece == BoardPiece::Bishop) {
+            direct |= getBmagic(kingPos, occ);
+        }
+        if (piece == BoardPiece::Queen || piece == BoardPiece::Rook) {
+            direct |= getRmagic(kingPos, occ);
+        }
+        direct &= toBB;
+        return direct || sliderChecks<IsWhite>(brd, kingPos, occ, fromBB);
+    }
+    if (kind == MoveKind::EnPassant) {
+        occ ^= 1ULL << (IsWhite ? to - 8 : to + 8);
+        return (cs.squares[0] & toBB) ||
+               sliderChecks<IsWhite>(brd, kingPos, occ, fromBB);
+    }
+    // Castling: only the rook, landing between the king's squares, can check.
+    const int rookFrom = to > from ? from + 3 : from - 4;
+    const int rookTo = (from + to) / 2;
+    occ = brd.Occ ^ fromBB ^ toBB ^ (1ULL << rookFrom) ^ (1ULL << rookTo);
+    return getRmagic(kingPos, occ) & (1ULL << rookTo);
 }
@@ -1,6 +1,9 @@
 #include "hash.hpp"
+#include "repetition.hpp"
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <utility>
 
 TranspositionTable TT(24);
 long ttc = 0;
@@ -11,6 +14,11 @@ TranspositionTable::TranspositionTable(uint64_t log2_size) {
     this->Table = (entry *)calloc(this->size, sizeof(entry));
 }
 
+void TranspositionTable::clear() {
+    memset(Table, 0, size * sizeof(entry));
+    age = 0;
+}
+
 void TranspositionTable::store(int depth, int val, int flag, uint64_t key,
                                uint8_t from, uint8_t to) {
     entry *node = &Table[key & (size - 1)];
@@ -165,3 +173,54 @@ uint64_t create_hash(const Board &board, bool isWhite) {
 
     return key;
 }
+
+struct CuckooTable {
+    std::array<uint64_t, CUCKOO_SIZE> keys{};
+    std::array<uint16_t, CUCKOO_SIZE> moves{};
+};
+
+static uint64_t empty_board_attacks(int type, int square) {
+    switch (type) {
+        case 1: return knightMasks[square];
+        case 2: return BishopMask[square];
+        case 3: return RookMask[square];
+        case 4: return BishopMask[square] | RookMask[square];
+        default: return kingMasks[square];
+    }
+}
+
+static CuckooTable cuckoo_init() {
+    CuckooTable table;
+    for (int color = 0; color < 2; color++) {
+        for (int type = 1; type < 6; type++) {
+            const int offset = color * 384 + type * 64;
+            for (int from = 0; from < 64; from++) {
+                for (int to = from + 1; to < 64; to++) {
+                    if (!((empty_board_attacks(type, from) >> to) & 1)) {
+                        continue;
+                    }
+                    uint64_t key = random_key[offset + from] ^
+                                   random_key[offset + to] ^ random_key[768];
+                    uint16_t move = from | to << 6;
+                    // Insert, kicking whatever holds the slot over to its
+                    // other one until a slot is free.
+                    int slot = cuckooSlot1(key);
+                    while (true) {
+                        std::swap(table.keys[slot], key);
+                        std::swap(table.moves[slot], move);
+                        if (key == 0) {
+                            break;
+                        }
+                        slot = slot == cuckooSlot1(key) ? cuckooSlot2(key)
+                                                        : cuckooSlot1(key);
+                    }
+                }
+            }
+        }
+    }
+    return table;
+}
+
+static const CuckooTable cuckoo_table = cuckoo_init();
+const std::array<uint64_t, CUCKOO_SIZE> cuckooKeys = cuckoo_table.keys;
+const std::array<uint16_t, CUCKOO_SIZE> cuckooMoves = cuckoo_table.moves;
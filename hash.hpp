@@ -54,6 +54,7 @@ public:
 
     void store(int depth, int val, int flag, uint64_t key, uint8_t from, uint8_t to);
     res probe_hash(int depth, int alpha, int beta, uint64_t key);
+    void clear();
 };
 
 uint64_t create_hash(const Board& board, bool isWhite);
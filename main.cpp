@@ -6,12 +6,17 @@
 #include <iostream>
 #include "SEE.hpp"
 #include <memory>
+#include <thread>
+#include <vector>
 #include "uci.hpp"
 #include "ai.hpp"
 #include "hash.hpp"
 #include "move.hpp"
 #include "eval.hpp"
 #include "movegen.hpp"
+#include "perft.hpp"
+#include "sliding.hpp"
+#include "train.hpp"
 int main(int argc, char** argv) {
 
     if (argc > 1 && std::string(argv[1]) == "bench") {
@@ -19,5 +24,72 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    if (argc > 1 && std::string(argv[1]) == "gamebench") {
+        runGameBench(argc > 2 ? std::stoi(argv[2]) : 16);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "evalfens") {
+        return nnue_eval_fens(std::cin, std::cout) ? 0 : 1;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "nnuebench") {
+        nnue_bench(argc > 2 ? std::stoi(argv[2]) : 1000000);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "sliderbench") {
+        return sliders_bench(argc > 2 ? std::stoi(argv[2]) : 100000000) ? 1
+                                                                         : 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "makebench") {
+        return runMakeBench(argc > 2 ? std::stoi(argv[2]) : 1000000);
+    }
+
+    if (argc > 1 && (std::string(argv[1]) == "perft" ||
+                     std::string(argv[1]) == "divide" ||
+                     std::string(argv[1]) == "perftsuite")) {
+        // chess2000 perft|divide <depth> [fen] [--threads N] [--hash MB]
+        // chess2000 perftsuite [maxDepth] [--threads N] [--hash MB]
+        std::string mode = argv[1];
+        int threads = mode == "perftsuite"
+                          ? 1
+                          : std::max(1u, std::thread::hardware_concurrency());
+        int hashMB = mode == "perftsuite" ? 0 : 64;
+        std::vector<std::string> args;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc) {
+                threads = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--hash" && i + 1 < argc) {
+                hashMB = std::stoi(argv[++i]);
+            } else {
+                args.push_back(arg);
+            }
+        }
+        if (mode == "perftsuite") {
+            int maxDepth = args.empty() ? 7 : std::stoi(args[0]);
+            return runPerftSuite(maxDepth, threads, hashMB) ? 1 : 0;
+        }
+        std::string fen =
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+        if (args.size() > 1) {
+            fen = args[1];
+            for (size_t i = 2; i < args.size(); i++) {
+                fen += " " + args[i];
+            }
+        }
+        perftDivide(loadFenBoard(fen), parseBoardState(fen.c_str()),
+                    parseEnPassantSquare(fen.c_str()),
+                    args.empty() ? 1 : std::stoi(args[0]), mode == "divide",
+                    threads, hashMB);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "train") {
+        return runTrain(argc, argv);
+    }
+
     uciRunGame();
 }
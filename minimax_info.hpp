@@ -1,10 +1,12 @@
 #pragma once
 #include "nnue.h"
+#include <cassert>
+#include <climits>
+#include <cstdint>
 struct minimax_info_t{
     int ep;
     int alpha;
     int beta;
-    int score;
     uint64_t key;
     int depth;
     int irreversibleCount;
@@ -14,7 +16,6 @@ struct minimax_info_t{
     bool nullMove;
     int from;
     int to;
-    minimax_info_t* prevMove;
     AccumulatorPair* accPair;
 };
 
@@ -23,12 +24,47 @@ struct move_info_t {
     int to;
     int alpha;
     int beta;
-    int score;
     uint64_t key;
     int depth;
     int irreversibleCount;
     int ply;
     bool isPVNode;
-    minimax_info_t* prevMove;
     AccumulatorPair* accPair;
 };
+
+// Most plies a search can go below its root.
+constexpr int MAX_PLY = 1024;
+
+// What later plies look back at. A node fills its frame on entry; the
+// frames above it are its ancestors, so they stay valid while it runs.
+struct SearchFrame {
+    int staticEval;
+    // Move that led here, 255 for the root and after a null move.
+    uint8_t from;
+    uint8_t to;
+    bool nullMove;
+    uint16_t killers[2];
+    // Plies since the last null move. Earlier positions can only recur
+    // through the pass, so repetition checks stop there.
+    int pliesFromNull;
+};
+
+// One per search thread, indexed by ply. The two frames in front of the
+// root make ply - 2 a valid index, and like the root they hold no move and
+// an eval that any node improves on.
+struct SearchStack {
+    SearchFrame frames[MAX_PLY + 2];
+
+    SearchFrame &operator[](int ply) noexcept {
+        assert(ply >= -2 && ply < MAX_PLY);
+        return frames[ply + 2];
+    }
+
+    void reset() noexcept {
+        for (SearchFrame &frame : frames) {
+            frame = SearchFrame{INT_MIN, 255, 255, false, {0, 0}, INT_MAX / 2};
+        }
+    }
+};
+
+inline thread_local SearchStack searchStack;
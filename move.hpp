@@ -351,38 +351,67 @@ struct MoveResult {
     BoardState state;
 };
 
-using SearchMoveFunc = int (*)(const Board &, move_info_t&);
-using MakeMoveFunc = MoveResult (*)(const Board &, int, int);
-
-struct Callback {
-    MakeMoveFunc makeMove;
-    SearchMoveFunc move;
-    uint8_t from;
-    uint8_t to;
-    int value;
-    bool capture;
-    bool promotion;
+// A move is 16 bits: from (6), to (6) and a MoveKind (4). The moving piece
+// is read from the mailbox when the move is made. Promotions keep the
+// promoted piece in the low two bits of the kind.
+enum class MoveKind : uint8_t {
+    Quiet,
+    DoublePush,
+    Capture,
+    EnPassant,
+    CastleLeft,
+    CastleRight,
+    Promote = 8,
+    PromoteCapture = 12,
 };
 
-/*
-static long long counter = 0;
-template <class BoardState status>
-constexpr inline int perft(const Board &brd, int ep,int a, int b, int c,
-uint64_t e, int depth,int hej) noexcept { if (depth == 0) { counter++; return 1;
-    } else {
-        Callback ml[100];
-        int count = 0;
-        genMoves<status,1,0>(brd, ep, ml, count);
-        //printf("count %d\n", count);
-        int cur = counter;
-        for (int i = 0; i < count; i++) {
-            ml[i].move(brd, ml[i].from, ml[i].to,a,b,c,0,depth - 1,hej);
-            printf("from %d to %d\n", ml[i].from, ml[i].to);
-        }
-        printf("count %d\n", counter-cur);
-    }
-    return counter;
-}*/
+using EncodedMove = uint16_t;
+
+// Promotion pieces in kind order.
+constexpr BoardPiece promotionPieces[4] = {
+    BoardPiece::Queen, BoardPiece::Rook, BoardPiece::Bishop,
+    BoardPiece::Knight};
+
+constexpr EncodedMove encodeMove(int from, int to, MoveKind kind,
+                                 int promotion = 0) noexcept {
+    return from | to << 6 | ((int)kind + promotion) << 12;
+}
+
+constexpr int moveFrom(EncodedMove move) noexcept { return move & 63; }
+
+constexpr int moveTo(EncodedMove move) noexcept { return move >> 6 & 63; }
+
+constexpr MoveKind moveKind(EncodedMove move) noexcept {
+    int kind = move >> 12;
+    return MoveKind(kind >= 8 ? kind & 12 : kind);
+}
+
+constexpr int movePromotion(EncodedMove move) noexcept {
+    return move >> 12 & 3;
+}
+
+constexpr bool isPromotion(EncodedMove move) noexcept {
+    return move >> 15;
+}
+
+constexpr bool isCapture(EncodedMove move) noexcept {
+    MoveKind kind = moveKind(move);
+    return kind == MoveKind::Capture || kind == MoveKind::EnPassant ||
+           kind == MoveKind::PromoteCapture;
+}
+
+// Neither a capture nor a promotion; castling and double pushes count.
+constexpr bool isQuietMove(EncodedMove move) noexcept {
+    return !isCapture(move) && !isPromotion(move);
+}
+
+// Generated moves with their ordering scores side by side. 256 covers the
+// 218 move maximum.
+struct MoveList {
+    EncodedMove moves[256];
+    int scores[256];
+    int count = 0;
+};
 
 template <class BoardState status>
 inline MoveResult makePawnMove(const Board &brd, int from, int to) noexcept {
@@ -406,19 +435,19 @@ inline MoveResult makePawnCapture(const Board &brd, int from, int to) noexcept {
     return {newBoard, status.normal()};
 }
 
-template <class BoardState status>
+template <class BoardState status, BoardPiece piece = BoardPiece::Queen>
 inline MoveResult makePromote(const Board &brd, int from, int to) noexcept {
-    Board newBoard = brd.promote<BoardPiece::Queen, status.IsWhite, status.WLC,
-                                 status.WRC, status.BLC, status.BRC>(from, to);
+    Board newBoard = brd.promote<piece, status.IsWhite, status.WLC, status.WRC,
+                                 status.BLC, status.BRC>(from, to);
     return {newBoard, status.normal()};
 }
 
-template <class BoardState status>
+template <class BoardState status, BoardPiece piece = BoardPiece::Queen>
 inline MoveResult makePromoteCapture(const Board &brd, int from,
                                      int to) noexcept {
     Board newBoard =
-        brd.promoteCapture<BoardPiece::Queen, status.IsWhite, status.WLC,
-                           status.WRC, status.BLC, status.BRC>(from, to);
+        brd.promoteCapture<piece, status.IsWhite, status.WLC, status.WRC,
+                           status.BLC, status.BRC>(from, to);
     return {newBoard, status.normal()};
 }
 
@@ -426,7 +455,7 @@ template <class BoardState status>
 inline MoveResult makeEP(const Board &brd, int from, int to) noexcept {
     Board newBoard = brd.EP<BoardPiece::Pawn, status.IsWhite, status.WLC,
                             status.WRC, status.BLC, status.BRC>(from, to);
-    return {newBoard, status.pawn()};
+    return {newBoard, status.normal()};
 }
 
 template <class BoardState status>
@@ -588,80 +617,103 @@ inline MoveResult makeRightCastel(const Board &brd, int from, int to) noexcept {
     }
 }
 
-// for perft testing
-// #define searchFunc perft
-// for minimax testing
+// The make path for perft and the UCI layer: plays `move` and returns the
+// new board with its state.
+template <class BoardState status>
+inline MoveResult makeMove(const Board &brd, EncodedMove move) noexcept {
+    const int from = moveFrom(move);
+    const int to = moveTo(move);
+    switch (moveKind(move)) {
+    case MoveKind::Quiet:
+        switch (BoardPiece(brd.pieceOn(from))) {
+        case BoardPiece::Pawn:
+            return makePawnMove<status>(brd, from, to);
+        case BoardPiece::Knight:
+            return makeKnightMove<status>(brd, from, to);
+        case BoardPiece::Bishop:
+            return makeBishopMove<status>(brd, from, to);
+        case BoardPiece::Rook:
+            return makeRookMove<status>(brd, from, to);
+        case BoardPiece::Queen:
+            return makeQueenMove<status>(brd, from, to);
+        default:
+            return makeKingMove<status>(brd, from, to);
+        }
+    case MoveKind::Capture:
+        switch (BoardPiece(brd.pieceOn(from))) {
+        case BoardPiece::Pawn:
+            return makePawnCapture<status>(brd, from, to);
+        case BoardPiece::Knight:
+            return makeKnightCapture<status>(brd, from, to);
+        case BoardPiece::Bishop:
+            return makeBishopCapture<status>(brd, from, to);
+        case BoardPiece::Rook:
+            return makeRookCapture<status>(brd, from, to);
+        case BoardPiece::Queen:
+            return makeQueenCapture<status>(brd, from, to);
+        default:
+            return makeKingCapture<status>(brd, from, to);
+        }
+    case MoveKind::DoublePush:
+        return makePawnDoubleMove<status>(brd, from, to);
+    // Only instantiated where the state allows them, as in genMoves.
+    case MoveKind::EnPassant:
+        if constexpr (status.EP) {
+            return makeEP<status>(brd, from, to);
+        }
+        __builtin_unreachable();
+    case MoveKind::CastleLeft:
+        if constexpr (status.IsWhite ? status.WLC : status.BLC) {
+            return makeLeftCastel<status>(brd, from, to);
+        }
+        __builtin_unreachable();
+    case MoveKind::CastleRight:
+        if constexpr (status.IsWhite ? status.WRC : status.BRC) {
+            return makeRightCastel<status>(brd, from, to);
+        }
+        __builtin_unreachable();
+    case MoveKind::Promote:
+        switch (movePromotion(move)) {
+        case 0:
+            return makePromote<status, BoardPiece::Queen>(brd, from, to);
+        case 1:
+            return makePromote<status, BoardPiece::Rook>(brd, from, to);
+        case 2:
+            return makePromote<status, BoardPiece::Bishop>(brd, from, to);
+        default:
+            return makePromote<status, BoardPiece::Knight>(brd, from, to);
+        }
+    default:
+        switch (movePromotion(move)) {
+        case 0:
+            return makePromoteCapture<status, BoardPiece::Queen>(brd, from, to);
+        case 1:
+            return makePromoteCapture<status, BoardPiece::Rook>(brd, from, to);
+        case 2:
+            return makePromoteCapture<status, BoardPiece::Bishop>(brd, from,
+                                                                  to);
+        default:
+            return makePromoteCapture<status, BoardPiece::Knight>(brd, from,
+                                                                  to);
+        }
+    }
+}
+
 #define searchFunc minimax
 #include <cassert>
 template <bool IsWhite>
 constexpr inline int getCapturePiece(const Board &brd, int to) noexcept {
-    int capturedPiece;
-    if constexpr (IsWhite) {
-        if (brd.BPawn & (1ULL << to))
-            capturedPiece = 0;
-        else if (brd.BKnight & (1ULL << to))
-            capturedPiece = 1;
-        else if (brd.BBishop & (1ULL << to))
-            capturedPiece = 2;
-        else if (brd.BRook & (1ULL << to))
-            capturedPiece = 3;
-        else if (brd.BQueen & (1ULL << to))
-            capturedPiece = 4;
-        else {
-            assert(false);
-        }
-    } else {
-        if (brd.WPawn & (1ULL << to))
-            capturedPiece = 0;
-        else if (brd.WKnight & (1ULL << to))
-            capturedPiece = 1;
-        else if (brd.WBishop & (1ULL << to))
-            capturedPiece = 2;
-        else if (brd.WRook & (1ULL << to))
-            capturedPiece = 3;
-        else if (brd.WQueen & (1ULL << to))
-            capturedPiece = 4;
-        else {
-
-            assert(false);
-        }
-    }
-    return capturedPiece;
+    return brd.pieceOn(to);
 }
 
+// Piece of the side not to move on `to`, 5 (king) when there is none.
 template <bool IsWhite>
 constexpr inline int getAttackerPiece(const Board &brd, int to) noexcept {
-    int capturedPiece;
-    if constexpr (IsWhite) {
-        if (brd.BPawn & (1ULL << to))
-            capturedPiece = 0;
-        else if (brd.BKnight & (1ULL << to))
-            capturedPiece = 1;
-        else if (brd.BBishop & (1ULL << to))
-            capturedPiece = 2;
-        else if (brd.BRook & (1ULL << to))
-            capturedPiece = 3;
-        else if (brd.BQueen & (1ULL << to))
-            capturedPiece = 4;
-        else {
-            capturedPiece = 5;
-        }
-    } else {
-        if (brd.WPawn & (1ULL << to))
-            capturedPiece = 0;
-        else if (brd.WKnight & (1ULL << to))
-            capturedPiece = 1;
-        else if (brd.WBishop & (1ULL << to))
-            capturedPiece = 2;
-        else if (brd.WRook & (1ULL << to))
-            capturedPiece = 3;
-        else if (brd.WQueen & (1ULL << to))
-            capturedPiece = 4;
-        else {
-            capturedPiece = 5;
-        }
+    const int piece = brd.pieceOn(to);
+    if (piece == NO_PIECE || brd.whiteOn(to) == IsWhite) {
+        return 5;
     }
-    return capturedPiece;
+    return piece;
 }
 
 template <bool IsWhite>
@@ -784,14 +836,12 @@ inline uint64_t toggle_side_to_move(uint64_t key) {
     searchInfo.ep = ep_val; \
     searchInfo.alpha = alpha; \
     searchInfo.beta = beta; \
-    searchInfo.score = score; \
     searchInfo.key = newKey; \
     searchInfo.depth = depth; \
     searchInfo.irreversibleCount = irreversible_val; \
     searchInfo.ply = ply; \
     searchInfo.isPVNode = isPVNode; \
     searchInfo.isCapture = capture_val; \
-    searchInfo.prevMove = prevMove; \
     searchInfo.from = from; \
     searchInfo.to = to; \
     searchInfo.nullMove = false; \
@@ -803,13 +853,11 @@ inline uint64_t toggle_side_to_move(uint64_t key) {
     int to = info.to; \
     int alpha = info.alpha; \
     int beta = info.beta; \
-    int score = info.score; \
     uint64_t key = info.key; \
     int depth = info.depth; \
     int irreversibleCount = info.irreversibleCount; \
     int ply = info.ply; \
     bool isPVNode = info.isPVNode; \
-    minimax_info_t* prevMove = info.prevMove; \
     AccumulatorPair* accPair = info.accPair; \
 
 
@@ -1304,3 +1352,64 @@ constexpr inline int rightCastel(const Board &brd,move_info_t& info) noexcept {
     }
     return val;
 }
+
+// The search path: makes `move`, updates key and accumulators and searches
+// the child. Captures go to quiescence when `qsearch` is set. Underpromotions
+// are never generated for the search.
+template <class BoardState status, bool qsearch>
+inline int searchMove(const Board &brd, EncodedMove move,
+                      move_info_t &info) noexcept {
+    switch (moveKind(move)) {
+    case MoveKind::Quiet:
+        switch (BoardPiece(brd.pieceOn(moveFrom(move)))) {
+        case BoardPiece::Pawn:
+            return pawnMove<status>(brd, info);
+        case BoardPiece::Knight:
+            return knightMove<status>(brd, info);
+        case BoardPiece::Bishop:
+            return bishopMove<status>(brd, info);
+        case BoardPiece::Rook:
+            return rookMove<status>(brd, info);
+        case BoardPiece::Queen:
+            return queenMove<status>(brd, info);
+        default:
+            return kingMove<status>(brd, info);
+        }
+    case MoveKind::Capture:
+        switch (BoardPiece(brd.pieceOn(moveFrom(move)))) {
+        case BoardPiece::Pawn:
+            return pawnCapture<status, qsearch>(brd, info);
+        case BoardPiece::Knight:
+            return knightCapture<status, qsearch>(brd, info);
+        case BoardPiece::Bishop:
+            return bishopCapture<status, qsearch>(brd, info);
+        case BoardPiece::Rook:
+            return rookCapture<status, qsearch>(brd, info);
+        case BoardPiece::Queen:
+            return queenCapture<status, qsearch>(brd, info);
+        default:
+            return kingCapture<status, qsearch>(brd, info);
+        }
+    case MoveKind::DoublePush:
+        return pawnDoubleMove<status>(brd, info);
+    case MoveKind::EnPassant:
+        if constexpr (status.EP) {
+            return EP<status>(brd, info);
+        }
+        __builtin_unreachable();
+    case MoveKind::CastleLeft:
+        if constexpr (status.IsWhite ? status.WLC : status.BLC) {
+            return leftCastel<status>(brd, info);
+        }
+        __builtin_unreachable();
+    case MoveKind::CastleRight:
+        if constexpr (status.IsWhite ? status.WRC : status.BRC) {
+            return rightCastel<status>(brd, info);
+        }
+        __builtin_unreachable();
+    case MoveKind::Promote:
+        return promote<status>(brd, info);
+    default:
+        return promoteCapture<status, qsearch>(brd, info);
+    }
+}
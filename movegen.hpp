@@ -4,18 +4,36 @@
 #include "constants.hpp"
 #include "move.hpp"
 #include "pawns.hpp"
+#include <array>
 #include <cassert>
 #include <cstdint>
 #include <iostream>
+#include <utility>
 #include "SEE.hpp"
 #include "parameter.hpp"
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 extern int historyTable[2][64][64];
 extern int captureHistoryTable[2][64][64];
 
-using SearchMoveFunc = int (*)(const Board &, move_info_t&);
+// Which moves genMoves emits. QSearch is captures only, for quiescence;
+// Noisy adds en passant and queen promotions; Quiet is everything Noisy
+// leaves out.
+enum class MoveGen { All, QSearch, Noisy, Quiet };
+
+constexpr bool genQuiets(MoveGen gen) {
+    return gen == MoveGen::All || gen == MoveGen::Quiet;
+}
+constexpr bool genQuietPromotions(MoveGen gen) {
+    return gen == MoveGen::All || gen == MoveGen::Noisy;
+}
+constexpr bool genCaptures(MoveGen gen) { return gen != MoveGen::Quiet; }
+constexpr bool genEP(MoveGen gen) {
+    return gen == MoveGen::All || gen == MoveGen::Noisy;
+}
 
-using MakeMoveFunc = MoveResult (*)(const Board &, int, int);
 inline std::string converter(int index) {
     int row = index / 8;
     int col = index % 8;
@@ -27,36 +45,32 @@ inline std::string converter(int index) {
     return std::string(1, file) + std::string(1, rank);
 }
 
-template <class BoardState status>
-inline void moveHandle(const Board &brd, const MakeMoveFunc &move, Callback *ml,
-                       int &count, int from, int to, int value) noexcept {
-    Callback &cb = ml[count++];
-    cb.makeMove = move;
-    cb.from = from;
-    cb.to = to;
-    cb.value = SEE(brd, from, to,0)*SEE_MULTIPLIER;
-}
-
-template <class BoardState status>
-_fast void moveHandle(const Board &brd, const SearchMoveFunc &move,
-                      Callback *ml, int &count, int from, int to, int value,
-                      bool capture, bool promotions) noexcept {
-
-    if ((brd.BKing & (1ULL << to))) {
-        assert(false);
+template <class BoardState status, bool search>
+_fast void moveHandle(const Board &brd, MoveList &ml, int from, int to,
+                      MoveKind kind, int value) noexcept {
+    assert(!((brd.WKing | brd.BKing) & (1ULL << to)));
+    ml.moves[ml.count] = encodeMove(from, to, kind);
+    if constexpr (search) {
+        ml.scores[ml.count] = value + historyTable[status.IsWhite][from][to];
     }
+    ml.count++;
+}
 
-    if ((brd.WKing & (1ULL << to))) {
-        assert(false);
+// The make path is what perft and the UCI layer play, so it emits every
+// promotion piece; the search only ever tries the queen.
+template <class BoardState status, bool search, bool capture>
+_fast void promotionHandle(const Board &brd, MoveList &ml, int from, int to,
+                           int value) noexcept {
+    constexpr MoveKind kind =
+        capture ? MoveKind::PromoteCapture : MoveKind::Promote;
+    for (int piece = 0; piece < (search ? 1 : 4); piece++) {
+        ml.moves[ml.count] = encodeMove(from, to, kind, piece);
+        if constexpr (search) {
+            ml.scores[ml.count] =
+                value + historyTable[status.IsWhite][from][to];
+        }
+        ml.count++;
     }
-    Callback &cb = ml[count++];
-    cb.move = move;
-    cb.from = from;
-    cb.to = to;
-    cb.capture = capture;
-    cb.promotion = promotions;
-    int history = historyTable[status.IsWhite][from][to];
-    cb.value = value + history;
 }
 
 static int values[6] = {10000, 30000, 30000, 50000, 90000, 0};
@@ -64,31 +78,7 @@ static int values[6] = {10000, 30000, 30000, 50000, 90000, 0};
 
 template <bool IsWhite>
 constexpr inline int getVictimValue(const Board &brd, int to) noexcept {
-    int capturedPiece;
-    if constexpr (IsWhite) {
-        if (brd.BPawn & (1ULL << to))
-            capturedPiece = 0;
-        else if (brd.BKnight & (1ULL << to))
-            capturedPiece = 1;
-        else if (brd.BBishop & (1ULL << to))
-            capturedPiece = 2;
-        else if (brd.BRook & (1ULL << to))
-            capturedPiece = 3;
-        else if (brd.BQueen & (1ULL << to))
-            capturedPiece = 4;
-    } else {
-        if (brd.WPawn & (1ULL << to))
-            capturedPiece = 0;
-        else if (brd.WKnight & (1ULL << to))
-            capturedPiece = 1;
-        else if (brd.WBishop & (1ULL << to))
-            capturedPiece = 2;
-        else if (brd.WRook & (1ULL << to))
-            capturedPiece = 3;
-        else if (brd.WQueen & (1ULL << to))
-            capturedPiece = 4;
-    }
-    return values[capturedPiece];
+    return values[brd.pieceOn(to)];
 }
 
 template <bool IsWhite>
@@ -99,6 +89,101 @@ int captureValue(const Board &brd, int to, int p) noexcept {
     return value;
 }
 
+// to << 6 | to per square. A bulk emitted move is its target's lane,
+// masked to the fields that come from the target, plus the constant rest.
+alignas(64) inline constexpr std::array<uint32_t, 64> squareLanes = [] {
+    std::array<uint32_t, 64> lanes{};
+    for (uint32_t sq = 0; sq < 64; sq++) {
+        lanes[sq] = sq << 6 | sq;
+    }
+    return lanes;
+}();
+
+// Appends (squareLanes[sq] & keep) + add for every sq in targets, in square
+// order, and history[sq] + value as its score if a history row is given.
+// With AVX-512 each 16 square chunk is one compress of the lanes (and the
+// scores) selected by the chunk's mask, stored in full: MoveList holds 256
+// moves, so the lanes past the end never leave the array.
+inline void emitBulk(MoveList &ml, uint64_t targets, uint32_t keep,
+                     uint32_t add, const int *history, int value) noexcept {
+#if defined(__AVX512F__)
+    const __m512i keepV = _mm512_set1_epi32(keep);
+    const __m512i addV = _mm512_set1_epi32(add);
+    for (int chunk = 0; targets; chunk += 16, targets >>= 16) {
+        const __mmask16 mask = (__mmask16)targets;
+        if (!mask) {
+            continue;
+        }
+        const __m512i lanes = _mm512_load_si512(&squareLanes[chunk]);
+        const __m512i moves = _mm512_maskz_compress_epi32(
+            mask, _mm512_add_epi32(_mm512_and_si512(lanes, keepV), addV));
+        _mm256_storeu_si256((__m256i *)&ml.moves[ml.count],
+                            _mm512_cvtepi32_epi16(moves));
+        if (history) {
+            const __m512i scores = _mm512_add_epi32(
+                _mm512_loadu_si512(history + chunk), _mm512_set1_epi32(value));
+            _mm512_storeu_si512(&ml.scores[ml.count],
+                                _mm512_maskz_compress_epi32(mask, scores));
+        }
+        ml.count += __builtin_popcount(mask);
+    }
+#else
+    Bitloop(targets) {
+        const int sq = __builtin_ctzll(targets);
+        ml.moves[ml.count] = (EncodedMove)((squareLanes[sq] & keep) + add);
+        if (history) {
+            ml.scores[ml.count] = history[sq] + value;
+        }
+        ml.count++;
+    }
+#endif
+}
+
+// from -> every square in targets, scored by the history row of from.
+template <class BoardState status, bool search>
+_fast void emitMoves(MoveList &ml, int from, uint64_t targets, MoveKind kind,
+                     int value) noexcept {
+    emitBulk(ml, targets, 0xFC0, encodeMove(from, 0, kind),
+             search ? historyTable[status.IsWhite][from] : nullptr, value);
+}
+
+// The search scores every capture by its victim, so it keeps the scalar
+// path; perft takes the bulk one.
+template <class BoardState status, bool search, int piece>
+_fast void emitCaptures(const Board &brd, MoveList &ml, int from,
+                        uint64_t targets) noexcept {
+    if constexpr (search) {
+        Bitloop(targets) {
+            const int to = __builtin_ctzll(targets);
+            const int value = captureValue<status.IsWhite>(brd, to, piece);
+            moveHandle<status, search>(brd, ml, from, to, MoveKind::Capture,
+                                       value);
+        }
+    } else {
+        emitMoves<status, search>(ml, from, targets, MoveKind::Capture, 0);
+    }
+}
+
+// Pawn moves from to + fromDelta. Their history rows differ per move, so
+// only perft emits them in bulk.
+template <class BoardState status, bool search>
+_fast void emitPawnMoves(const Board &brd, MoveList &ml, int fromDelta,
+                         uint64_t targets, MoveKind kind) noexcept {
+    if constexpr (search) {
+        Bitloop(targets) {
+            const int to = __builtin_ctzll(targets);
+            const int value = kind == MoveKind::Capture
+                                  ? captureValue<status.IsWhite>(brd, to, 0)
+                                  : 0;
+            moveHandle<status, search>(brd, ml, to + fromDelta, to, kind,
+                                       value);
+        }
+    } else {
+        emitBulk(ml, targets, 0xFFF,
+                 (uint32_t)fromDelta + encodeMove(0, 0, kind), nullptr, 0);
+    }
+}
+
 template <bool IsWhite> _fast uint64_t enemyOrEmpty(const Board &brd) noexcept {
     if constexpr (IsWhite) {
         return brd.Black | ~brd.Occ;
@@ -106,9 +191,9 @@ template <bool IsWhite> _fast uint64_t enemyOrEmpty(const Board &brd) noexcept {
     return brd.White | ~brd.Occ;
 }
 
-template <class BoardState status, bool search, bool capturesOnly>
+template <class BoardState status, bool search, MoveGen gen>
 _fast static void pawnMoves(const Board &brd, uint64_t chessMask, int64_t pinHV,
-                            uint64_t pinD, Callback *ml, int &count) noexcept {
+                            uint64_t pinD, MoveList &ml) noexcept {
     uint64_t pinnedD, pinnedHV, notPinned;
     if constexpr (status.IsWhite) {
         pinnedD = brd.WPawn & pinD;
@@ -120,90 +205,43 @@ _fast static void pawnMoves(const Board &brd, uint64_t chessMask, int64_t pinHV,
         notPinned = brd.BPawn & ~(pinnedD | pinnedHV);
     }
     uint64_t promotions = 0;
-    if constexpr (!capturesOnly) {
+    if constexpr (genQuiets(gen) || genQuietPromotions(gen)) {
         uint64_t forwardNotPinned =
             (pawnForward<status.IsWhite>(notPinned, brd)) & chessMask;
         uint64_t fowardPinned =
             (pawnForward<status.IsWhite>(pinnedHV, brd)) & chessMask & pinHV;
         uint64_t forward = forwardNotPinned | fowardPinned;
-        promotions = promotion(forward);
-        forward = forward & (~promotions);
+        promotions = genQuietPromotions(gen) ? promotion(forward) : 0;
+        forward = genQuiets(gen) ? forward & ~promotion(forward) : 0;
         Bitloop(promotions) {
             const int to = __builtin_ctzll(promotions);
             if constexpr (status.IsWhite) {
                 const int from = to - 8;
-                if constexpr (search) {
-                    moveHandle<status>(brd, promote<status>, ml, count, from,
-                                       to, PROMOTE, 0, 1);
-                } else {
-                    moveHandle<status>(brd, makePromote<status>, ml, count,
-                                       from, to, PROMOTE);
-                }
+                promotionHandle<status, search, false>(brd, ml, from, to,
+                                                       PROMOTE);
             } else {
                 const int from = to + 8;
-                if constexpr (search) {
-                    moveHandle<status>(brd, promote<status>, ml, count, from,
-                                       to, PROMOTE, 0, 1);
-                } else {
-                    moveHandle<status>(brd, makePromote<status>, ml, count,
-                                       from, to, PROMOTE);
-                }
-            }
-        }
-        Bitloop(forward) {
-            const int to = __builtin_ctzll(forward);
-            if constexpr (status.IsWhite) {
-                const int from = to - 8;
-                if constexpr (search) {
-                    moveHandle<status>(brd, pawnMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makePawnMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            } else {
-                const int from = to + 8;
-                if constexpr (search) {
-                    moveHandle<status>(brd, pawnMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makePawnMove<status>, ml, count,
-                                       from, to, 0);
-                }
+                promotionHandle<status, search, false>(brd, ml, from, to,
+                                                       PROMOTE);
             }
         }
+        emitPawnMoves<status, search>(brd, ml, status.IsWhite ? -8 : 8,
+                                      forward, MoveKind::Quiet);
         uint64_t doubleForwardNotPinned =
             pawnDoubleForward<status.IsWhite>(notPinned, brd) & chessMask;
         uint64_t doubleForwardPinned =
             pawnDoubleForward<status.IsWhite>(pinnedHV, brd) & chessMask &
             pinHV;
-        uint64_t doubleForward = doubleForwardNotPinned | doubleForwardPinned;
-        Bitloop(doubleForward) {
-            const int to = __builtin_ctzll(doubleForward);
-            if constexpr (status.IsWhite) {
-                const int from = to - 16;
-                if constexpr (search) {
-                    moveHandle<status>(brd, pawnDoubleMove<status>, ml, count,
-                                       from, to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makePawnDoubleMove<status>, ml,
-                                       count, from, to, 0);
-                }
-            } else {
-                const int from = to + 16;
-                if constexpr (search) {
-                    moveHandle<status>(brd, pawnDoubleMove<status>, ml, count,
-                                       from, to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makePawnDoubleMove<status>, ml,
-                                       count, from, to, 0);
-                }
-            }
-        }
+        uint64_t doubleForward =
+            genQuiets(gen) ? doubleForwardNotPinned | doubleForwardPinned : 0;
+        emitPawnMoves<status, search>(brd, ml, status.IsWhite ? -16 : 16,
+                                      doubleForward, MoveKind::DoublePush);
     }
     uint64_t leftNotPinned = pawnAttackLeft<status.IsWhite>(notPinned, brd);
     uint64_t leftPinned = pawnAttackLeft<status.IsWhite>(pinnedD, brd);
-    uint64_t left = (leftNotPinned | (leftPinned & pinD)) & chessMask;
+    uint64_t left = genCaptures(gen)
+                        ? (leftNotPinned | (leftPinned & pinD)) & chessMask
+                        : 0;
     promotions = promotion(left);
     left = left & ~promotions;
     Bitloop(promotions) {
@@ -211,51 +249,20 @@ _fast static void pawnMoves(const Board &brd, uint64_t chessMask, int64_t pinHV,
         const int value = captureValue<status.IsWhite>(brd, to, 0) + PROMOTE;
         if constexpr (status.IsWhite) {
             const int from = to - 7;
-            if constexpr (search) {
-                moveHandle<status>(brd, promoteCapture<status, capturesOnly>,
-                                   ml, count, from, to, value, 1, 1);
-            } else {
-                moveHandle<status>(brd, makePromote<status>, ml, count, from,
-                                   to, value);
-            }
+            promotionHandle<status, search, true>(brd, ml, from, to, value);
 
         } else {
             const int from = to + 9;
-            if constexpr (search) {
-                moveHandle<status>(brd, promoteCapture<status, capturesOnly>,
-                                   ml, count, from, to, value, 1, 1);
-            } else {
-                moveHandle<status>(brd, makePromote<status>, ml, count, from,
-                                   to, value);
-            }
-        }
-    }
-    Bitloop(left) {
-        const int to = __builtin_ctzll(left);
-        const int value = captureValue<status.IsWhite>(brd, to, 0);
-        if constexpr (status.IsWhite) {
-            const int from = to - 7;
-            if constexpr (search) {
-                moveHandle<status>(brd, pawnCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makePawnCapture<status>, ml, count,
-                                   from, to, value);
-            }
-        } else {
-            const int from = to + 9;
-            if constexpr (search) {
-                moveHandle<status>(brd, pawnCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makePawnCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            promotionHandle<status, search, true>(brd, ml, from, to, value);
         }
     }
+    emitPawnMoves<status, search>(brd, ml, status.IsWhite ? -7 : 9, left,
+                                  MoveKind::Capture);
     uint64_t rightNotPinned = pawnAttackRight<status.IsWhite>(notPinned, brd);
     uint64_t rightPinned = pawnAttackRight<status.IsWhite>(pinnedD, brd);
-    uint64_t right = (rightNotPinned | (rightPinned & pinD)) & chessMask;
+    uint64_t right = genCaptures(gen)
+                         ? (rightNotPinned | (rightPinned & pinD)) & chessMask
+                         : 0;
     promotions = promotion(right);
     right = right & ~promotions;
     Bitloop(promotions) {
@@ -263,53 +270,20 @@ _fast static void pawnMoves(const Board &brd, uint64_t chessMask, int64_t pinHV,
         const int value = captureValue<status.IsWhite>(brd, to, 0) + PROMOTE;
         if constexpr (status.IsWhite) {
             const int from = to - 9;
-            if constexpr (search) {
-                moveHandle<status>(brd, promoteCapture<status, capturesOnly>,
-                                   ml, count, from, to, value, 1, 1);
-            } else {
-                moveHandle<status>(brd, makePromoteCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            promotionHandle<status, search, true>(brd, ml, from, to, value);
         } else {
             const int from = to + 7;
-            if constexpr (search) {
-                moveHandle<status>(brd, promoteCapture<status, capturesOnly>,
-                                   ml, count, from, to, value, 1, 1);
-            } else {
-                moveHandle<status>(brd, makePromoteCapture<status>, ml, count,
-                                   from, to, value);
-            }
-        }
-    }
-    Bitloop(right) {
-        const int to = __builtin_ctzll(right);
-        const int value = captureValue<status.IsWhite>(brd, to, 0);
-        if constexpr (status.IsWhite) {
-            const int from = to - 9;
-            if constexpr (search) {
-                moveHandle<status>(brd, pawnCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makePawnCapture<status>, ml, count,
-                                   from, to, value);
-            }
-        } else {
-            const int from = to + 7;
-            if constexpr (search) {
-                moveHandle<status>(brd, pawnCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makePawnCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            promotionHandle<status, search, true>(brd, ml, from, to, value);
         }
     }
+    emitPawnMoves<status, search>(brd, ml, status.IsWhite ? -9 : 7, right,
+                                  MoveKind::Capture);
 }
 
-template <class BoardState status, bool search, bool capturesOnly>
+template <class BoardState status, bool search, MoveGen gen>
 _fast static void knightMoves(const Board &brd, uint64_t chessMask,
-                              uint64_t pinHV, uint64_t pinD, Callback *ml,
-                              int &count) noexcept {
+                              uint64_t pinHV, uint64_t pinD,
+                              MoveList &ml) noexcept {
     uint64_t knights;
     if constexpr (status.IsWhite) {
         knights = brd.WKnight & ~(pinHV | pinD);
@@ -320,38 +294,19 @@ _fast static void knightMoves(const Board &brd, uint64_t chessMask,
         const int from = __builtin_ctzll(knights);
         uint64_t attacks =
             knightMasks[from] & chessMask & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, knightMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeKnightMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 1);
-            if constexpr (search) {
-                moveHandle<status>(brd, knightCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeKnightCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 1>(brd, ml, from, captures);
     }
 }
 
-template <class BoardState status, bool search, bool capturesOnly>
+template <class BoardState status, bool search, MoveGen gen>
 _fast static void bishopMoves(const Board &brd, uint64_t chessMask,
-                              uint64_t pinHV, uint64_t pinD, Callback *ml,
-                              int &count) noexcept {
+                              uint64_t pinHV, uint64_t pinD,
+                              MoveList &ml) noexcept {
     uint64_t bishopsNotPinned, bishopsPinnedD;
     if constexpr (status.IsWhite) {
         bishopsNotPinned = brd.WBishop & ~(pinHV | pinD);
@@ -364,69 +319,31 @@ _fast static void bishopMoves(const Board &brd, uint64_t chessMask,
         const int from = __builtin_ctzll(bishopsNotPinned);
         uint64_t attacks = getBmagic(from, brd.Occ);
         attacks = attacks & chessMask & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, bishopMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeBishopMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 2);
-            if constexpr (search) {
-                moveHandle<status>(brd, bishopCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeBishopCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 2>(brd, ml, from, captures);
     }
     Bitloop(bishopsPinnedD) {
         const int from = __builtin_ctzll(bishopsPinnedD);
         uint64_t attacks = getBmagic(from, brd.Occ);
         attacks =
             attacks & chessMask & pinD & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, bishopMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeBishopMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 2);
-            if constexpr (search) {
-                moveHandle<status>(brd, bishopCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeBishopCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 2>(brd, ml, from, captures);
     }
 }
 
-template <class BoardState status, bool search, bool capturesOnly>
+template <class BoardState status, bool search, MoveGen gen>
 _fast static void queenMoves(const Board &brd, uint64_t chessMask,
-                             uint64_t pinHV, uint64_t pinD, Callback *ml,
-                             int &count) noexcept {
+                             uint64_t pinHV, uint64_t pinD,
+                             MoveList &ml) noexcept {
     uint64_t queenNotPinned, queenPinnedD, queenPinnedHV;
     if constexpr (status.IsWhite) {
         queenNotPinned = brd.WQueen & ~(pinHV | pinD);
@@ -441,100 +358,43 @@ _fast static void queenMoves(const Board &brd, uint64_t chessMask,
         const int from = __builtin_ctzll(queenNotPinned);
         uint64_t attacks = getQmagic(from, brd.Occ);
         attacks = attacks & chessMask & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, queenMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeQueenMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 4);
-            if constexpr (search) {
-                moveHandle<status>(brd, queenCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeQueenCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 4>(brd, ml, from, captures);
     }
     Bitloop(queenPinnedD) {
         const int from = __builtin_ctzll(queenPinnedD);
         uint64_t attacks = getBmagic(from, brd.Occ);
         attacks =
             attacks & chessMask & pinD & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, queenMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeQueenMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 4);
-            if constexpr (search) {
-                moveHandle<status>(brd, queenCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeQueenCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 4>(brd, ml, from, captures);
     }
     Bitloop(queenPinnedHV) {
         const int from = __builtin_ctzll(queenPinnedHV);
         uint64_t attacks = getRmagic(from, brd.Occ);
         attacks =
             attacks & chessMask & pinHV & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, queenMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeQueenMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 4);
-            if constexpr (search) {
-                moveHandle<status>(brd, queenCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeQueenCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 4>(brd, ml, from, captures);
     }
 }
 
-template <class BoardState status, bool search, bool capturesOnly>
+template <class BoardState status, bool search, MoveGen gen>
 _fast static void rookMoves(const Board &brd, uint64_t chessMask,
-                            uint64_t pinHV, uint64_t pinD, Callback *ml,
-                            int &count) noexcept {
+                            uint64_t pinHV, uint64_t pinD,
+                            MoveList &ml) noexcept {
     uint64_t rooksNotPinned, rooksPinnedHV;
     if constexpr (status.IsWhite) {
         rooksNotPinned = brd.WRook & ~(pinHV | pinD);
@@ -547,149 +407,71 @@ _fast static void rookMoves(const Board &brd, uint64_t chessMask,
         const int from = __builtin_ctzll(rooksNotPinned);
         uint64_t attacks = getRmagic(from, brd.Occ);
         attacks = attacks & chessMask & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, rookMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeRookMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 3);
-            if constexpr (search) {
-                moveHandle<status>(brd, rookCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeRookCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 3>(brd, ml, from, captures);
     }
     Bitloop(rooksPinnedHV) {
         const int from = __builtin_ctzll(rooksPinnedHV);
         uint64_t attacks = getRmagic(from, brd.Occ);
         attacks =
             attacks & chessMask & pinHV & enemyOrEmpty<status.IsWhite>(brd);
-        uint64_t captures = attacks & brd.Occ;
-        if constexpr (!capturesOnly) {
+        uint64_t captures = genCaptures(gen) ? attacks & brd.Occ : 0;
+        if constexpr (genQuiets(gen)) {
             attacks = attacks & ~brd.Occ;
-            Bitloop(attacks) {
-                const int to = __builtin_ctzll(attacks);
-                if constexpr (search) {
-                    moveHandle<status>(brd, rookMove<status>, ml, count, from,
-                                       to, 0, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeRookMove<status>, ml, count,
-                                       from, to, 0);
-                }
-            }
-        }
-        Bitloop(captures) {
-            const int to = __builtin_ctzll(captures);
-            const int value = captureValue<status.IsWhite>(brd, to, 3);
-            if constexpr (search) {
-                moveHandle<status>(brd, rookCapture<status, capturesOnly>, ml,
-                                   count, from, to, value, 1, 0);
-            } else {
-                moveHandle<status>(brd, makeRookCapture<status>, ml, count,
-                                   from, to, value);
-            }
+            emitMoves<status, search>(ml, from, attacks, MoveKind::Quiet, 0);
         }
+        emitCaptures<status, search, 3>(brd, ml, from, captures);
     }
 }
 
-template <class BoardState status, bool search, bool capturesOnly>
+template <class BoardState status, bool search, MoveGen gen>
 _fast static void kingMoves(const Board &brd, uint64_t chessMask,
-                            uint64_t kingBan, int kingPos, Callback *ml,
-                            int &count) noexcept {
+                            uint64_t kingBan, int kingPos,
+                            MoveList &ml) noexcept {
     uint64_t moves =
         kingMasks[kingPos] & ~kingBan & enemyOrEmpty<status.IsWhite>(brd);
-    uint64_t captures = moves & brd.Occ;
-    if constexpr (!capturesOnly) {
+    uint64_t captures = genCaptures(gen) ? moves & brd.Occ : 0;
+    if constexpr (genQuiets(gen)) {
         moves = moves & ~brd.Occ;
-        Bitloop(moves) {
-            const int to = __builtin_ctzll(moves);
-            if constexpr (search) {
-                moveHandle<status>(brd, kingMove<status>, ml, count, kingPos,
-                                   to, 0, 0, 0);
-            } else {
-                moveHandle<status>(brd, makeKingMove<status>, ml, count,
-                                   kingPos, to, 0);
-            }
-        }
-    }
-    Bitloop(captures) {
-        const int to = __builtin_ctzll(captures);
-        const int value = captureValue<status.IsWhite>(brd, to, 5);
-        if constexpr (search) {
-            moveHandle<status>(brd, kingCapture<status, capturesOnly>, ml,
-                               count, kingPos, to, value, 1, 0);
-        } else {
-            moveHandle<status>(brd, makeKingCapture<status>, ml, count, kingPos,
-                               to, value);
-        }
+        emitMoves<status, search>(ml, kingPos, moves, MoveKind::Quiet, 0);
     }
+    emitCaptures<status, search, 5>(brd, ml, kingPos, captures);
 }
 
 template <class BoardState status, bool search>
-_fast void castels(const Board &brd, uint64_t kingBan, Callback *ml,
-                   int &count) noexcept {
+_fast void castels(const Board &brd, uint64_t kingBan, MoveList &ml) noexcept {
     if constexpr (status.IsWhite) {
         if constexpr (status.WLC) {
             if ((!(WNotOccupiedL & brd.Occ)) && (!(WNotAttackedL & kingBan)) &&
-                (brd.WRook & WRookL)) {
-                if constexpr (search) {
-                    moveHandle<status>(brd, leftCastel<status>, ml, count, 4, 2,
-                                       CASTLE, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeLeftCastel<status>, ml, count,
-                                       4, 2, CASTLE);
-                }
+                (brd.WRook & WRookL) && brd.canCastle(4, 0)) {
+                moveHandle<status, search>(brd, ml, 4, 2, MoveKind::CastleLeft,
+                                           CASTLE);
             }
         }
         if constexpr (status.WRC) {
             if ((!(WNotOccupiedR & brd.Occ)) && (!(WNotAttackedR & kingBan)) &&
-                (brd.WRook & WRookR)) {
-                if constexpr (search) {
-                    moveHandle<status>(brd, rightCastel<status>, ml, count, 4,
-                                       6, CASTLE, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeRightCastel<status>, ml, count,
-                                       4, 6, CASTLE);
-                }
+                (brd.WRook & WRookR) && brd.canCastle(4, 7)) {
+                moveHandle<status, search>(brd, ml, 4, 6, MoveKind::CastleRight,
+                                           CASTLE);
             }
         }
     } else {
         if constexpr (status.BLC) {
             if ((!(BNotOccupiedL & brd.Occ)) && (!(BNotAttackedL & kingBan)) &&
-                (brd.BRook & BRookL)) {
-                if constexpr (search) {
-                    moveHandle<status>(brd, leftCastel<status>, ml, count, 60,
-                                       58, CASTLE, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeLeftCastel<status>, ml, count,
-                                       60, 58, CASTLE);
-                }
+                (brd.BRook & BRookL) && brd.canCastle(60, 56)) {
+                moveHandle<status, search>(brd, ml, 60, 58,
+                                           MoveKind::CastleLeft, CASTLE);
             }
         }
         if constexpr (status.BRC) {
             if ((!(BNotOccupiedR & brd.Occ)) && (!(BNotAttackedR & kingBan)) &&
-                (brd.BRook & BRookR)) {
-                if constexpr (search) {
-                    moveHandle<status>(brd, rightCastel<status>, ml, count, 60,
-                                       62, CASTLE, 0, 0);
-                } else {
-                    moveHandle<status>(brd, makeRightCastel<status>, ml, count,
-                                       60, 62, CASTLE);
-                }
+                (brd.BRook & BRookR) && brd.canCastle(60, 63)) {
+                moveHandle<status, search>(brd, ml, 60, 62,
+                                           MoveKind::CastleRight, CASTLE);
             }
         }
     }
@@ -718,14 +500,14 @@ _fast bool isEPPinned(const Board &brd, uint64_t kingPos,
 }
 
 template <class BoardState status, bool search>
-_fast void EPMoves(const Board &brd, int ep, Callback *ml, int &count,
-                   uint64_t pinD, uint64_t pinHV, uint64_t checkmask) noexcept {
-    if ((checkmask != ~0ULL) &&
-        !(checkmask & (1ULL << (ep + (status.IsWhite ? -8 : 8))))) {
+_fast void EPMoves(const Board &brd, int ep, MoveList &ml, uint64_t pinD,
+                   uint64_t pinHV, uint64_t checkmask) noexcept {
+    if (ep == -1) {
         return;
     }
 
-    if (ep == -1) {
+    if ((checkmask != ~0ULL) &&
+        !(checkmask & (1ULL << (ep + (status.IsWhite ? -8 : 8))))) {
         return;
     }
     uint64_t EPRight, EPLeft, EPLeftPinned, EPRightPinned;
@@ -757,13 +539,8 @@ _fast void EPMoves(const Board &brd, int ep, Callback *ml, int &count,
         uint64_t movedPiecesRay = fromBB | EPSquare | capturedPawnBB;
 
         if (!isEPPinned<status>(brd, kingPos, movedPiecesRay)) {
-            if constexpr (search) {
-                moveHandle<status>(brd, EP<status>, ml, count, from, to, EP_VAL,
-                                   1, 0);
-            } else {
-                moveHandle<status>(brd, makeEP<status>, ml, count, from, to,
-                                   EP_VAL);
-            }
+            moveHandle<status, search>(brd, ml, from, to, MoveKind::EnPassant,
+                                       EP_VAL);
         }
     }
 
@@ -776,59 +553,213 @@ _fast void EPMoves(const Board &brd, int ep, Callback *ml, int &count,
         uint64_t movedPiecesRay = fromBB | EPSquare | capturedPawnBB;
 
         if (!isEPPinned<status>(brd, kingPos, movedPiecesRay)) {
-            if constexpr (search) {
-                moveHandle<status>(brd, EP<status>, ml, count, from, to, EP_VAL,
-                                   1, 0);
-            } else {
-                moveHandle<status>(brd, makeEP<status>, ml, count, from, to,
-                                   EP_VAL);
+            moveHandle<status, search>(brd, ml, from, to, MoveKind::EnPassant,
+                                       EP_VAL);
+        }
+    }
+}
+
+// Moves out of check: king moves, and against a single checker the moves
+// onto checkmask that capture it or block its ray. A pinned piece can never
+// do either, and checkmask holds at most seven squares, so the pieces are
+// found from those squares instead of generating every piece. Castling is
+// never legal here.
+template <class BoardState status, bool search, MoveGen gen>
+_fast void genEvasions(const Board &brd, int ep, MoveList &ml,
+                       const AttackInfo &attacks, int kingPos) noexcept {
+    if (!(attacks.checkers & (attacks.checkers - 1))) {
+        const uint64_t checkmask = attacks.checkmask;
+        const uint64_t pinned = attacks.pinHV | attacks.pinD;
+        pawnMoves<status, search, gen>(brd, checkmask, attacks.pinHV,
+                                       attacks.pinD, ml);
+        const uint64_t knights =
+            (status.IsWhite ? brd.WKnight : brd.BKnight) & ~pinned;
+        const uint64_t queens = status.IsWhite ? brd.WQueen : brd.BQueen;
+        const uint64_t diagonal =
+            ((status.IsWhite ? brd.WBishop : brd.BBishop) | queens) & ~pinned;
+        const uint64_t orthogonal =
+            ((status.IsWhite ? brd.WRook : brd.BRook) | queens) & ~pinned;
+        uint64_t targets = checkmask & (genQuiets(gen) ? ONES : brd.Occ) &
+                           (genCaptures(gen) ? ONES : ~brd.Occ);
+        Bitloop(targets) {
+            const int to = __builtin_ctzll(targets);
+            uint64_t from = knightMasks[to] & knights;
+            if (diagonal) {
+                from |= getBmagic(to, brd.Occ) & diagonal;
+            }
+            if (orthogonal) {
+                from |= getRmagic(to, brd.Occ) & orthogonal;
+            }
+            const bool capture = brd.Occ & (1ULL << to);
+            Bitloop(from) {
+                const int sq = __builtin_ctzll(from);
+                if (capture) {
+                    moveHandle<status, search>(
+                        brd, ml, sq, to, MoveKind::Capture,
+                        captureValue<status.IsWhite>(brd, to, brd.pieceOn(sq)));
+                } else {
+                    moveHandle<status, search>(brd, ml, sq, to,
+                                               MoveKind::Quiet, 0);
+                }
             }
         }
+        if constexpr ((status.EP) && genEP(gen)) {
+            EPMoves<status, search>(brd, ep, ml, attacks.pinD, attacks.pinHV,
+                                    checkmask);
+        }
     }
+    kingMoves<status, search, gen>(brd, attacks.checkmask, attacks.kingBan,
+                                   kingPos, ml);
 }
 
-template <class BoardState status, bool search, bool capturesOnly>
-_fast uint64_t genMoves(const Board &brd, int ep, Callback *ml,
-                        int &count) noexcept {
-    uint64_t king;
-    if constexpr (status.IsWhite) {
-        king = brd.WKing;
-    } else {
-        king = brd.BKing;
+// Generation with the node's attack info already at hand.
+template <class BoardState status, bool search, MoveGen gen>
+_fast void genMoves(const Board &brd, int ep, MoveList &ml,
+                    const AttackInfo &attacks) noexcept {
+    const int kingPos =
+        __builtin_ctzll(status.IsWhite ? brd.WKing : brd.BKing);
+    if (attacks.inCheck()) {
+        genEvasions<status, search, gen>(brd, ep, ml, attacks, kingPos);
+        return;
     }
-    int kingPos = __builtin_ctzll(king);
-    uint64_t checkmask = ONES;
-    uint64_t pinHV = 0;
-    uint64_t pinD = 0;
-    uint64_t kingBan = 0;
-    generateCheck<status.IsWhite>(brd, kingPos, pinHV, pinD, checkmask,
-                                  kingBan);
+    const uint64_t checkmask = attacks.checkmask;
+    const uint64_t pinHV = attacks.pinHV;
+    const uint64_t pinD = attacks.pinD;
+    const uint64_t kingBan = attacks.kingBan;
 
-    pawnMoves<status, search, capturesOnly>(brd, checkmask, pinHV, pinD, ml,
-                                            count);
-    knightMoves<status, search, capturesOnly>(brd, checkmask, pinHV, pinD, ml,
-                                              count);
-    bishopMoves<status, search, capturesOnly>(brd, checkmask, pinHV, pinD, ml,
-                                              count);
-    queenMoves<status, search, capturesOnly>(brd, checkmask, pinHV, pinD, ml,
-                                             count);
-    rookMoves<status, search, capturesOnly>(brd, checkmask, pinHV, pinD, ml,
-                                            count);
-    kingMoves<status, search, capturesOnly>(brd, checkmask, kingBan, kingPos,
-                                            ml, count);
+    pawnMoves<status, search, gen>(brd, checkmask, pinHV, pinD, ml);
+    knightMoves<status, search, gen>(brd, checkmask, pinHV, pinD, ml);
+    bishopMoves<status, search, gen>(brd, checkmask, pinHV, pinD, ml);
+    queenMoves<status, search, gen>(brd, checkmask, pinHV, pinD, ml);
+    rookMoves<status, search, gen>(brd, checkmask, pinHV, pinD, ml);
+    kingMoves<status, search, gen>(brd, checkmask, kingBan, kingPos, ml);
     if constexpr ((status.WLC || status.WRC || status.BLC || status.BRC) &&
-                  (!capturesOnly)) {
-        castels<status, search>(brd, kingBan, ml, count);
+                  genQuiets(gen)) {
+        castels<status, search>(brd, kingBan, ml);
     }
-    if constexpr ((status.EP) && (!capturesOnly)) {
-        EPMoves<status, search>(brd, ep, ml, count, pinD, pinHV, checkmask);
+    if constexpr ((status.EP) && genEP(gen)) {
+        EPMoves<status, search>(brd, ep, ml, pinD, pinHV, checkmask);
     }
-    return kingBan;
 }
 
-template <bool search, bool capturesOnly>
-_fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
-                           bool WH, bool EP, bool WL, bool WR, bool BL,
+template <class BoardState status, bool search, MoveGen gen>
+_fast uint64_t genMoves(const Board &brd, int ep, MoveList &ml) noexcept {
+    const AttackInfo attacks = generateCheck<status.IsWhite>(brd);
+    genMoves<status, search, gen>(brd, ep, ml, attacks);
+    return attacks.kingBan;
+}
+
+// Legal capture targets of every own piece, worked out once per quiescence
+// node. emit() then hands out the captures of one victim type at a time,
+// attackers from pawn up to king, so calling it for queens down to pawns
+// yields the QSearch moves of genMoves in MVV-LVA order without a sort, and
+// a cutoff leaves the later victims unemitted.
+template <class BoardState status> class CaptureTargets {
+  public:
+    CaptureTargets(const Board &brd, const AttackInfo &attacks) noexcept {
+        const uint64_t checkmask = attacks.checkmask;
+        const uint64_t pinHV = attacks.pinHV;
+        const uint64_t pinD = attacks.pinD;
+        const uint64_t enemy = status.IsWhite ? brd.Black : brd.White;
+        const uint64_t pawns = status.IsWhite ? brd.WPawn : brd.BPawn;
+        const uint64_t notPinned = pawns & ~(pinHV | pinD);
+        const uint64_t pinnedD = pawns & pinD;
+        pawnLeft = (pawnAttackLeft<status.IsWhite>(notPinned, brd) |
+                    (pawnAttackLeft<status.IsWhite>(pinnedD, brd) & pinD)) &
+                   checkmask;
+        pawnRight = (pawnAttackRight<status.IsWhite>(notPinned, brd) |
+                     (pawnAttackRight<status.IsWhite>(pinnedD, brd) & pinD)) &
+                    checkmask;
+
+        const uint64_t targets = enemy & checkmask;
+        uint64_t knights =
+            (status.IsWhite ? brd.WKnight : brd.BKnight) & ~(pinHV | pinD);
+        Bitloop(knights) {
+            const int sq = __builtin_ctzll(knights);
+            add(sq, 1, knightMasks[sq] & targets);
+        }
+        uint64_t bishops = (status.IsWhite ? brd.WBishop : brd.BBishop) & ~pinHV;
+        Bitloop(bishops) {
+            const int sq = __builtin_ctzll(bishops);
+            add(sq, 2, getBmagic(sq, brd.Occ) & targets &
+                           (pinD & (1ULL << sq) ? pinD : ONES));
+        }
+        uint64_t rooks = (status.IsWhite ? brd.WRook : brd.BRook) & ~pinD;
+        Bitloop(rooks) {
+            const int sq = __builtin_ctzll(rooks);
+            add(sq, 3, getRmagic(sq, brd.Occ) & targets &
+                           (pinHV & (1ULL << sq) ? pinHV : ONES));
+        }
+        uint64_t queens = status.IsWhite ? brd.WQueen : brd.BQueen;
+        Bitloop(queens) {
+            const int sq = __builtin_ctzll(queens);
+            const uint64_t bb = 1ULL << sq;
+            add(sq, 4,
+                (pinD & bb    ? getBmagic(sq, brd.Occ) & pinD
+                 : pinHV & bb ? getRmagic(sq, brd.Occ) & pinHV
+                              : getQmagic(sq, brd.Occ)) &
+                    targets);
+        }
+        const int kingPos =
+            __builtin_ctzll(status.IsWhite ? brd.WKing : brd.BKing);
+        add(kingPos, 5, kingMasks[kingPos] & enemy & ~attacks.kingBan);
+    }
+
+    // Appends the captures of the pieces in `victims`, all of one type.
+    void emit(const Board &brd, uint64_t victims, MoveList &ml) const noexcept {
+        emitPawn(brd, pawnLeft & victims, status.IsWhite ? -7 : 9, ml);
+        emitPawn(brd, pawnRight & victims, status.IsWhite ? -9 : 7, ml);
+        for (int i = 0; i < count; i++) {
+            uint64_t targets = pieceTargets[i] & victims;
+            Bitloop(targets) {
+                const int to = __builtin_ctzll(targets);
+                moveHandle<status, true>(
+                    brd, ml, from[i], to, MoveKind::Capture,
+                    captureValue<status.IsWhite>(brd, to, piece[i]));
+            }
+        }
+    }
+
+    // Whether any pawn capture promotes.
+    bool promotes() const noexcept {
+        return promotion(pawnLeft | pawnRight) != 0;
+    }
+
+  private:
+    void add(int sq, int type, uint64_t targets) noexcept {
+        if (targets) {
+            from[count] = sq;
+            piece[count] = type;
+            pieceTargets[count++] = targets;
+        }
+    }
+
+    static void emitPawn(const Board &brd, uint64_t targets, int fromDelta,
+                         MoveList &ml) noexcept {
+        uint64_t promotions = promotion(targets);
+        Bitloop(promotions) {
+            const int to = __builtin_ctzll(promotions);
+            promotionHandle<status, true, true>(
+                brd, ml, to + fromDelta, to,
+                captureValue<status.IsWhite>(brd, to, 0) + PROMOTE);
+        }
+        emitPawnMoves<status, true>(brd, ml, fromDelta,
+                                    targets & ~promotion(targets),
+                                    MoveKind::Capture);
+    }
+
+    uint64_t pawnLeft, pawnRight;
+    // Knights, bishops, rooks, queens, then the king; only pieces that have
+    // a capture are kept.
+    int count = 0;
+    uint8_t from[16];
+    uint8_t piece[16];
+    uint64_t pieceTargets[16];
+};
+
+template <bool search, MoveGen gen>
+_fast uint64_t moveGenCall(const Board &brd, int ep, MoveList &ml, bool WH,
+                           bool EP, bool WL, bool WR, bool BL,
                            bool BR) noexcept {
     if (WH) {
         if (EP) {
@@ -838,48 +769,40 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{true, true, true, true,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, true, true,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, true, true, true,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, true, true,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{true, true, true, false,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, true, false,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, true, true, false,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, true, false,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             } else {
@@ -888,48 +811,40 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{true, true, false, true,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, false, true,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, true, false, true,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, false, true,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{true, true, false, false,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, false, false,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, true, false, false,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, true, false, false,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             }
@@ -940,48 +855,40 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{true, false, true, true,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, true, true,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, false, true, true,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, true, true,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{true, false, true, false,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, true, false,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, false, true, false,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, true, false,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             } else {
@@ -990,48 +897,40 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{true, false, false, true,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, false, true,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, false, false, true,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, false, true,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{true, false, false,
                                                        false, true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, false,
                                                        false, true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{true, false, false,
                                                        false, false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{true, false, false,
                                                        false, false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             }
@@ -1044,48 +943,40 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{false, true, true, true,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, true, true,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, true, true, true,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, true, true,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{false, true, true, false,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, true, false,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, true, true, false,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, true, false,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             } else {
@@ -1094,48 +985,40 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{false, true, false, true,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, false, true,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, true, false, true,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, false, true,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{false, true, false,
                                                        false, true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, false,
                                                        false, true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, true, false,
                                                        false, false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, true, false,
                                                        false, false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             }
@@ -1146,48 +1029,40 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{false, false, true, true,
                                                        true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, true, true,
                                                        true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, false, true, true,
                                                        false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, true, true,
                                                        false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{false, false, true,
                                                        false, true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, true,
                                                        false, true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, false, true,
                                                        false, false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, true,
                                                        false, false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             } else {
@@ -1196,51 +1071,77 @@ _fast uint64_t moveGenCall(const Board &brd, int ep, Callback *ml, int &count,
                         if (BR)
                             return genMoves<BoardState{false, false, false,
                                                        true, true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, false,
                                                        true, true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, false, false,
                                                        true, false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, false,
                                                        true, false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 } else {
                     if (BL) {
                         if (BR)
                             return genMoves<BoardState{false, false, false,
                                                        false, true, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, false,
                                                        false, true, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     } else {
                         if (BR)
                             return genMoves<BoardState{false, false, false,
                                                        false, false, true},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                         else
                             return genMoves<BoardState{false, false, false,
                                                        false, false, false},
-                                            search, capturesOnly>(brd, ep, ml,
-                                                                  count);
+                                            search, gen>(brd, ep, ml);
                     }
                 }
             }
         }
     }
 }
+
+template <int index> constexpr BoardState stateFromIndex() {
+    return BoardState(index & 32, index & 16, index & 8, index & 4, index & 2,
+                      index & 1);
+}
+
+template <class F, size_t... I>
+inline decltype(auto) stateCallImpl(int index, F &f,
+                                    std::index_sequence<I...>) {
+    using R = decltype(f.template operator()<BoardState{}>());
+    static constexpr R (*table[])(F &) = {[](F &g) -> R {
+        return g.template operator()<stateFromIndex<I>()>();
+    }...};
+    return table[index](f);
+}
+
+// Calls f.template operator()<status>() for a state only known at runtime.
+// For the root and the UCI loop, where one call per move is not worth
+// another hand written tree like moveGenCall.
+template <class F>
+inline decltype(auto) stateCall(bool WH, bool EP, bool WL, bool WR, bool BL,
+                                bool BR, F &&f) {
+    int index = WH << 5 | EP << 4 | WL << 3 | WR << 2 | BL << 1 | BR;
+    return stateCallImpl(index, f, std::make_index_sequence<64>());
+}
+
+// makeMove for a state only known at runtime.
+inline MoveResult makeMove(const Board &brd, const BoardState &state,
+                           EncodedMove move) noexcept {
+    return stateCall(state.IsWhite, state.EP, state.WLC, state.WRC, state.BLC,
+                     state.BRC, [&]<BoardState status>() {
+                         return makeMove<status>(brd, move);
+                     });
+}
@@ -0,0 +1,343 @@
+#pragma once
+#include "SEE.hpp"
+#include "board.hpp"
+#include "movegen.hpp"
+#include "parameter.hpp"
+#include <cstdint>
+
+// Packed from << 8 | to, as stored in the killer and counter tables.
+constexpr uint16_t NO_MOVE = 0xFFFF;
+
+// Finds the encoded move for from -> to if it is legal here, without
+// generating moves. The mailbox gives the piece and the attack tables its
+// targets over the current occupancy; the node's attack info supplies the
+// pins, the check evasions and the squares the king may not enter. The
+// tests mirror genMoves, so only moves it would emit are found (queen
+// promotions, and with gen Quiet only what the quiet stage generates).
+// Castling and en passant are checked by their own generators.
+template <class BoardState status, MoveGen gen>
+inline bool findMove(const Board &brd, int ep, uint16_t packed,
+                     const AttackInfo &attacks, EncodedMove &move) noexcept {
+    const int from = packed >> 8;
+    const int to = packed & 0xFF;
+    if (from >= 64 || to >= 64 || from == to) {
+        return false;
+    }
+    const uint64_t own = status.IsWhite ? brd.White : brd.Black;
+    const uint64_t fromBB = 1ULL << from;
+    const uint64_t toBB = 1ULL << to;
+    if (!(own & fromBB) || (own & toBB)) {
+        return false;
+    }
+    const bool capture = brd.Occ & toBB;
+    if (capture && !genCaptures(gen)) {
+        return false;
+    }
+    MoveKind kind = capture ? MoveKind::Capture : MoveKind::Quiet;
+    const int piece = brd.pieceOn(from);
+
+    if (piece == 5) {
+        if (to == from + 2 || to == from - 2) {
+            if constexpr (genQuiets(gen)) {
+                MoveList ml;
+                if (!attacks.inCheck()) {
+                    castels<status, 1>(brd, attacks.kingBan, ml);
+                }
+                for (int i = 0; i < ml.count; i++) {
+                    if (moveTo(ml.moves[i]) == to) {
+                        move = ml.moves[i];
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        if (!(kingMasks[from] & ~attacks.kingBan & toBB)) {
+            return false;
+        }
+        move = encodeMove(from, to, kind);
+        return true;
+    }
+
+    // Only the king gets out of a double check.
+    if (attacks.checkers & (attacks.checkers - 1)) {
+        return false;
+    }
+    const uint64_t pinHV = attacks.pinHV & fromBB ? attacks.pinHV : ONES;
+    const uint64_t pinD = attacks.pinD & fromBB ? attacks.pinD : ONES;
+    uint64_t targets = 0;
+    switch (piece) {
+    case 0: {
+        const int push = status.IsWhite ? 8 : -8;
+        if (to == ep) {
+            if constexpr (status.EP && genEP(gen)) {
+                MoveList ml;
+                EPMoves<status, 1>(brd, ep, ml, attacks.pinD, attacks.pinHV,
+                                   attacks.checkmask);
+                for (int i = 0; i < ml.count; i++) {
+                    if (moveFrom(ml.moves[i]) == from) {
+                        move = ml.moves[i];
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        if (pinD != ONES && pinHV == ONES && !capture) {
+            return false;
+        }
+        if (to == from + push) {
+            targets = pawnForward<status.IsWhite>(fromBB, brd) & pinHV;
+        } else if (to == from + 2 * push) {
+            targets = pawnDoubleForward<status.IsWhite>(fromBB, brd) & pinHV;
+            kind = MoveKind::DoublePush;
+        } else if (pinHV == ONES) {
+            targets = (pawnAttackLeft<status.IsWhite>(fromBB, brd) |
+                       pawnAttackRight<status.IsWhite>(fromBB, brd)) &
+                      pinD;
+        }
+        if (toBB & Rank_18) {
+            if (!capture && !genQuietPromotions(gen)) {
+                return false;
+            }
+            kind = capture ? MoveKind::PromoteCapture : MoveKind::Promote;
+        }
+        break;
+    }
+    case 1:
+        targets = (pinHV & pinD) == ONES ? knightMasks[from] : 0;
+        break;
+    case 2:
+        targets = pinHV == ONES ? getBmagic(from, brd.Occ) & pinD : 0;
+        break;
+    case 3:
+        targets = pinD == ONES ? getRmagic(from, brd.Occ) & pinHV : 0;
+        break;
+    case 4:
+        targets = pinD != ONES    ? getBmagic(from, brd.Occ) & pinD
+                  : pinHV != ONES ? getRmagic(from, brd.Occ) & pinHV
+                                  : getQmagic(from, brd.Occ);
+        break;
+    }
+    if (!(targets & attacks.checkmask & toBB)) {
+        return false;
+    }
+    move = encodeMove(from, to, kind);
+    return true;
+}
+
+// Staged move ordering for minimax: PV and TT move, good captures, killers
+// and counter move, quiets, then captures that lose material. Each stage is
+// generated only when the previous ones are exhausted and moves are taken
+// by selection instead of sorting the whole list.
+template <class BoardState status> class MovePicker {
+  public:
+    enum Stage {
+        HashMoves,
+        GenNoisy,
+        GoodNoisy,
+        Refutations,
+        GenQuiets,
+        Quiets,
+        BadNoisy,
+        Done
+    };
+
+    MovePicker(const Board &brd, int ep, const AttackInfo &attacks,
+               uint16_t pvMove, uint16_t ttMove, uint16_t killer1,
+               uint16_t killer2, uint16_t counterMove, uint16_t followUpMove,
+               const int16_t (*captureHistory)[64])
+        : brd(brd), ep(ep), attacks(attacks), followUpMove(followUpMove),
+          captureHistory(captureHistory) {
+        special[0] = pvMove;
+        special[1] = ttMove == pvMove ? NO_MOVE : ttMove;
+        special[2] = killer1;
+        special[3] = killer2 == killer1 ? NO_MOVE : killer2;
+        special[4] = counterMove;
+        for (int i = 3; i < 5; i++) {
+            for (int j = 2; j < i; j++) {
+                if (special[i] == special[j]) {
+                    special[i] = NO_MOVE;
+                }
+            }
+        }
+    }
+
+    // Quiet stages are not generated once the search would prune them.
+    void skipQuiets() noexcept { quietsSkipped = true; }
+
+    // From here on only quiets that give check are handed out, unscored.
+    void onlyQuietChecks(const CheckSquares &cs) noexcept {
+        checkSquares = &cs;
+    }
+
+    bool next(EncodedMove &move) noexcept {
+        switch (stage) {
+        case HashMoves:
+            while (current < 2) {
+                uint16_t candidate = special[current++];
+                if (candidate != NO_MOVE &&
+                    findMove<status, MoveGen::All>(brd, ep, candidate, attacks,
+                                                   move)) {
+                    tried[triedCount++] = candidate;
+                    return true;
+                }
+            }
+            stage = GenNoisy;
+            [[fallthrough]];
+        case GenNoisy:
+            ml.count = 0;
+            genMoves<status, 1, MoveGen::Noisy>(brd, ep, ml, attacks);
+            count = ml.count;
+            for (int i = 0; i < count; i++) {
+                ml.scores[i] +=
+                    captureHistory[moveFrom(ml.moves[i])][moveTo(ml.moves[i])];
+            }
+            current = 0;
+            stage = GoodNoisy;
+            [[fallthrough]];
+        case GoodNoisy:
+            while (current < count) {
+                selectBest();
+                EncodedMove candidate = ml.moves[current++];
+                if (wasTried(candidate)) {
+                    continue;
+                }
+                if (losesMaterial(candidate)) {
+                    ml.moves[badCount++] = candidate;
+                    continue;
+                }
+                move = candidate;
+                return true;
+            }
+            current = 2;
+            stage = Refutations;
+            [[fallthrough]];
+        case Refutations:
+            while (!quietsSkipped && current < 5) {
+                uint16_t candidate = special[current++];
+                if (candidate != NO_MOVE && !wasTriedPacked(candidate) &&
+                    findMove<status, MoveGen::Quiet>(brd, ep, candidate,
+                                                     attacks, move)) {
+                    tried[triedCount++] = candidate;
+                    if (filtered(move)) {
+                        continue;
+                    }
+                    return true;
+                }
+            }
+            stage = GenQuiets;
+            [[fallthrough]];
+        case GenQuiets:
+            current = badCount;
+            ml.count = badCount;
+            if (!quietsSkipped) {
+                genMoves<status, 1, MoveGen::Quiet>(brd, ep, ml, attacks);
+                for (int i = badCount; i < ml.count; i++) {
+                    if (packed(ml.moves[i]) == followUpMove) {
+                        ml.scores[i] += FOLLOW_UP_BONUS;
+                    }
+                }
+            }
+            quietEnd = ml.count;
+            stage = Quiets;
+            [[fallthrough]];
+        case Quiets:
+            while (!quietsSkipped && current < quietEnd) {
+                if (checkSquares == nullptr) {
+                    selectBest(quietEnd);
+                }
+                EncodedMove candidate = ml.moves[current++];
+                if (!wasTried(candidate) && !filtered(candidate)) {
+                    move = candidate;
+                    return true;
+                }
+            }
+            current = 0;
+            stage = BadNoisy;
+            [[fallthrough]];
+        case BadNoisy:
+            if (current < badCount) {
+                move = ml.moves[current++];
+                return true;
+            }
+            stage = Done;
+            [[fallthrough]];
+        case Done:
+            return false;
+        }
+        return false;
+    }
+
+  private:
+    static uint16_t packed(EncodedMove move) noexcept {
+        return (uint16_t)(moveFrom(move) << 8 | moveTo(move));
+    }
+
+    // A quiet dropped by onlyQuietChecks.
+    bool filtered(EncodedMove move) const noexcept {
+        return checkSquares != nullptr &&
+               !givesCheck<status.IsWhite>(brd, *checkSquares, move);
+    }
+
+    bool wasTriedPacked(uint16_t move) const noexcept {
+        for (int i = 0; i < triedCount; i++) {
+            if (tried[i] == move) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool wasTried(EncodedMove move) const noexcept {
+        return wasTriedPacked(packed(move));
+    }
+
+    // Plain captures that SEE says lose material wait for the last stage.
+    // When the enemy attacks neither square there is no recapture and no
+    // x-ray through the from square, so SEE is skipped.
+    bool losesMaterial(EncodedMove move) const noexcept {
+        const uint64_t squares = 1ULL << moveFrom(move) | 1ULL << moveTo(move);
+        return moveKind(move) == MoveKind::Capture &&
+               (attacks.kingBan & squares) &&
+               !seeGE(brd, move, 0);
+    }
+
+    void selectBest(int end = -1) noexcept {
+        if (end < 0) {
+            end = count;
+        }
+        int best = current;
+        for (int i = current + 1; i < end; i++) {
+            if (ml.scores[i] > ml.scores[best]) {
+                best = i;
+            }
+        }
+        if (best != current) {
+            std::swap(ml.moves[best], ml.moves[current]);
+            std::swap(ml.scores[best], ml.scores[current]);
+        }
+    }
+
+    const Board &brd;
+    const int ep;
+    const AttackInfo &attacks;
+    const uint16_t followUpMove;
+    const int16_t (*captureHistory)[64];
+
+    Stage stage = HashMoves;
+    bool quietsSkipped = false;
+    const CheckSquares *checkSquares = nullptr;
+    // pv, tt, killer 1, killer 2, counter
+    uint16_t special[5];
+    uint16_t tried[5];
+    int triedCount = 0;
+
+    // Noisy moves fill ml from 0; the bad ones are compacted to the front
+    // as they are found, and quiets are generated behind them.
+    MoveList ml;
+    int count = 0;
+    int current = 0;
+    int badCount = 0;
+    int quietEnd = 0;
+};
@@ -27,45 +27,8 @@ void nnue_init(AccumulatorPair *pair, const Board &brd) {
 
     while (occ) {
         int square = __builtin_ctzll(occ);
-        int piece_type, piece_color;
-
-        if ((1ULL << square) & brd.WPawn) {
-            piece_type = 0;
-            piece_color = 1;
-        } else if ((1ULL << square) & brd.WKnight) {
-            piece_type = 1;
-            piece_color = 1;
-        } else if ((1ULL << square) & brd.WBishop) {
-            piece_type = 2;
-            piece_color = 1;
-        } else if ((1ULL << square) & brd.WRook) {
-            piece_type = 3;
-            piece_color = 1;
-        } else if ((1ULL << square) & brd.WQueen) {
-            piece_type = 4;
-            piece_color = 1;
-        } else if ((1ULL << square) & brd.WKing) {
-            piece_type = 5;
-            piece_color = 1;
-        } else if ((1ULL << square) & brd.BPawn) {
-            piece_type = 0;
-            piece_color = 0;
-        } else if ((1ULL << square) & brd.BKnight) {
-            piece_type = 1;
-            piece_color = 0;
-        } else if ((1ULL << square) & brd.BBishop) {
-            piece_type = 2;
-            piece_color = 0;
-        } else if ((1ULL << square) & brd.BRook) {
-            piece_type = 3;
-            piece_color = 0;
-        } else if ((1ULL << square) & brd.BQueen) {
-            piece_type = 4;
-            piece_color = 0;
-        } else if ((1ULL << square) & brd.BKing) {
-            piece_type = 5;
-            piece_color = 0;
-        }
+        int piece_type = brd.pieceOn(square);
+        int piece_color = brd.whiteOn(square);
 
         int white_idx = calculate_idx(piece_type, piece_color, square, 1);
         int black_idx = calculate_idx(piece_type, piece_color, square, 0);
@@ -303,3 +266,118 @@ int nnue_evaluate(AccumulatorPair *pair, int side_to_move) {
 
     return output / (256 * 64);
 }
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const char *nnue_kernel_name() {
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    return "AVX-512";
+#elif defined(__AVX2__)
+    return "AVX2";
+#else
+    return "scalar";
+#endif
+}
+
+// Reads one position per line (a FEN, optionally followed by "| eval | wdl"
+// as in the training data) and writes the quantized side-to-move evaluation
+// for each, so nnue_check.py can diff it against the float model. Output
+// line i belongs to input line i, so a line without a side to move stops
+// the run with an error naming it instead of being skipped.
+bool nnue_eval_fens(std::istream &in, std::ostream &out) {
+    AccumulatorPair *pair = (AccumulatorPair *)aligned_alloc(64, sizeof(AccumulatorPair));
+    std::string line;
+    bool ok = true;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+        std::string fen = line.substr(0, line.find('|'));
+        size_t space = fen.find(' ');
+        if (space == std::string::npos || space + 1 >= fen.size() ||
+            (fen[space + 1] != 'w' && fen[space + 1] != 'b')) {
+            std::cerr << "evalfens: line " << lineNumber
+                      << " has no side to move: " << line << std::endl;
+            ok = false;
+            break;
+        }
+        bool isWhite = fen[space + 1] == 'w';
+        nnue_init(pair, loadFenBoard(fen));
+        out << -nnue_evaluate(pair, isWhite) << '\n';
+    }
+    out.flush();
+    free(pair);
+    return ok;
+}
+
+static const char *benchFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "r2q1rk1/ppp2ppp/2n1bn2/2b1p3/3pP3/3P1NPP/PPP1NPB1/R1BQ1RK1 b - - 0 9",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "2k5/8/8/8/8/8/8/3K4 w - - 0 1",
+};
+
+template <typename F> static double timeKernel(int iterations, F &&kernel) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        kernel(i);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+    return duration.count();
+}
+
+static void printKernel(const char *name, int iterations, double seconds) {
+    printf("%-12s %12.0f per s %9.1f ns\n", name, iterations / seconds,
+           seconds * 1e9 / iterations);
+}
+
+// Per-kernel throughput of the compiled SIMD level. Build with
+// -DSIMD_LEVEL=SCALAR/AVX2/AVX512 to compare the three code paths.
+void nnue_bench(int iterations) {
+    constexpr int fenCount = sizeof(benchFens) / sizeof(benchFens[0]);
+    std::vector<Board> boards;
+    for (int i = 0; i < fenCount; i++) {
+        boards.push_back(loadFenBoard(benchFens[i]));
+    }
+    AccumulatorPair *pair = (AccumulatorPair *)aligned_alloc(64, sizeof(AccumulatorPair));
+    volatile int sink = 0;
+
+    printf("kernel %s, HL %d, %d iterations\n", nnue_kernel_name(), HL_SIZE,
+           iterations);
+
+    double refresh = timeKernel(iterations, [&](int i) {
+        nnue_init(pair, boards[i % fenCount]);
+        sink = sink + pair->white.values[i % HL_SIZE];
+    });
+    printKernel("refresh", iterations, refresh);
+
+    // A quiet knight move made and unmade, as the search does per node.
+    nnue_init(pair, boards[0]);
+    double incremental = timeKernel(iterations, [&](int i) {
+        accumulatorSubAddPiece(pair, 1, 1, 6, 21);
+        accumulatorSubAddPiece(pair, 1, 1, 21, 6);
+        sink = sink + pair->black.values[i % HL_SIZE];
+    });
+    printKernel("incremental", iterations * 2, incremental);
+
+    // Kiwipete's e5 knight takes the d7 pawn and the capture is undone.
+    nnue_init(pair, boards[1]);
+    double capture = timeKernel(iterations, [&](int i) {
+        accumulatorSubAddCapture(pair, 1, 1, 0, 0, 36, 51, false);
+        accumulatorSubAddCapture(pair, 1, 1, 0, 0, 51, 36, true);
+        sink = sink + pair->white.values[i % HL_SIZE];
+    });
+    printKernel("capture", iterations * 2, capture);
+
+    double output = timeKernel(iterations, [&](int i) {
+        sink = sink + nnue_evaluate(pair, i & 1);
+    });
+    printKernel("output", iterations, output);
+
+    free(pair);
+}
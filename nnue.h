@@ -26,3 +26,9 @@ void accumulatorSubPiece(AccumulatorPair* pair, int piece_type, int piece_color,
 void accumulatorSubAddPiece(AccumulatorPair* pair, int piece_type, int piece_color, int from, int to);
 
 int nnue_evaluate(AccumulatorPair* pair, int side_to_move);
+
+const char *nnue_kernel_name();
+
+bool nnue_eval_fens(std::istream &in, std::ostream &out);
+
+void nnue_bench(int iterations);
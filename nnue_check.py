@@ -0,0 +1,164 @@
+import argparse
+import re
+import subprocess
+import numpy as np
+import torch
+import torch.nn as nn
+
+# Quantization used by nnue.cpp: accumulator values are scaled by QA
+# (ACTIVATION_CLIP), output weights by QB, and the output bias by QA * QB.
+QA = 256
+QB = 64
+INPUT_SIZE = 768
+
+
+def read_array(header, name):
+    match = re.search(name + r"\s*(?:\[\d+\])+\s*=\s*\{(.*?)\};", header, re.DOTALL)
+    if match is None:
+        match = re.search(name + r"\s*=\s*(-?\d+)\s*;", header)
+        return np.array([int(match.group(1))], dtype=np.float64)
+    body = match.group(1).replace("{", " ").replace("}", " ")
+    return np.array([int(x) for x in body.split(",") if x.strip()], dtype=np.float64)
+
+
+class EngineNNUE(nn.Module):
+    """Float version of the engine net: 768 -> HL (shared), SCReLU, 2*HL -> 1.
+
+    This is the layout network_weights*.hpp holds. The NNUE class in nnue.py
+    has an extra 32-wide hidden layer and cannot be loaded by the engine, so
+    parity is checked against this model instead.
+    """
+
+    def __init__(self, hl_size):
+        super().__init__()
+        self.ft = nn.Linear(INPUT_SIZE, hl_size)
+        self.out = nn.Linear(2 * hl_size, 1)
+
+    def forward(self, own_features, opp_features):
+        own = torch.clamp(self.ft(own_features), 0.0, 1.0) ** 2
+        opp = torch.clamp(self.ft(opp_features), 0.0, 1.0) ** 2
+        return self.out(torch.cat([own, opp], dim=1))
+
+
+def load_engine_weights(path):
+    header = open(path).read()
+    ft_w = read_array(header, "FEATURE_WEIGHTS")
+    ft_b = read_array(header, "FEATURE_BIAS")
+    out_w = read_array(header, "OUTPUT_WEIGHTS")
+    out_b = read_array(header, "OUTPUT_BIAS")
+    hl_size = len(ft_b)
+
+    # nnue_evaluate computes (OUTPUT_BIAS + sum(clip(acc)^2 * w)) / (QA * QB),
+    # so in float units the output weights carry an extra QA / QB.
+    model = EngineNNUE(hl_size)
+    with torch.no_grad():
+        model.ft.weight.copy_(torch.tensor(ft_w.reshape(INPUT_SIZE, hl_size).T / QA))
+        model.ft.bias.copy_(torch.tensor(ft_b / QA))
+        model.out.weight.copy_(torch.tensor(out_w.reshape(1, 2 * hl_size) * QA / QB))
+        model.out.bias.copy_(torch.tensor(out_b / (QA * QB)))
+    return model.double()
+
+
+def fen_to_engine_features(fen):
+    """Feature indices as calculate_idx() in nnue.cpp produces them.
+
+    Squares are a1 = 0 .. h8 = 63. Returns (white perspective, black
+    perspective) index lists.
+    """
+    board_part = fen.split()[0]
+    white, black = [], []
+    rank, file = 7, 0
+    for char in board_part:
+        if char == "/":
+            rank -= 1
+            file = 0
+        elif char.isdigit():
+            file += int(char)
+        else:
+            square = rank * 8 + file
+            color = 1 if char.isupper() else 0
+            piece_type = "PNBRQK".index(char.upper())
+            white.append((color ^ 1) * 384 + piece_type * 64 + square)
+            black.append(color * 384 + piece_type * 64 + (square ^ 56))
+            file += 1
+    return white, black
+
+
+def reference_evals(model, fens, batch_size=4096):
+    evals = []
+    for start in range(0, len(fens), batch_size):
+        batch = fens[start:start + batch_size]
+        own = torch.zeros(len(batch), INPUT_SIZE, dtype=torch.float64)
+        opp = torch.zeros(len(batch), INPUT_SIZE, dtype=torch.float64)
+        for i, fen in enumerate(batch):
+            white, black = fen_to_engine_features(fen)
+            white_to_move = fen.split()[1] == "w"
+            # nnue_evaluate(pair, IsWhite) reads the side *not* to move as
+            # "own"; the search negates it to get the side-to-move score.
+            own_idx, opp_idx = (black, white) if white_to_move else (white, black)
+            own[i, own_idx] = 1.0
+            opp[i, opp_idx] = 1.0
+        with torch.no_grad():
+            evals.extend((-model(own, opp)).squeeze(1).tolist())
+    return np.array(evals)
+
+
+def engine_evals(engine, fens):
+    result = subprocess.run([engine, "evalfens"], input="\n".join(fens) + "\n",
+                            capture_output=True, text=True)
+    if result.returncode != 0:
+        raise SystemExit(f"{engine}: {result.stderr.strip()}")
+    return np.array([int(x) for x in result.stdout.split()], dtype=np.float64)
+
+
+def read_fens(path, count):
+    fens = []
+    with open(path) as f:
+        for line in f:
+            fen = line.split("|")[0].strip()
+            if len(fen.split()) >= 2:
+                fens.append(fen)
+            if len(fens) >= count:
+                break
+    return fens
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the quantized C++ NNUE against the float model")
+    parser.add_argument("--engine", action="append", required=True,
+                        help="engine binary; repeat to compare SIMD builds")
+    parser.add_argument("--fens", required=True, help="FEN per line, or 'fen | eval | wdl' data")
+    parser.add_argument("-n", type=int, default=10000, help="number of positions")
+    parser.add_argument("--weights", default="network_weights4.hpp")
+    parser.add_argument("--state-dict", help="float EngineNNUE state_dict to compare instead")
+    parser.add_argument("--top", type=int, default=10, help="worst offenders to print")
+    parser.add_argument("--bench-iterations", type=int, default=1000000)
+    args = parser.parse_args()
+
+    if args.state_dict:
+        model = EngineNNUE(len(read_array(open(args.weights).read(), "FEATURE_BIAS")))
+        model.load_state_dict(torch.load(args.state_dict, map_location="cpu"))
+        model = model.double()
+    else:
+        model = load_engine_weights(args.weights)
+    model.eval()
+
+    fens = read_fens(args.fens, args.n)
+    reference = reference_evals(model, fens)
+    print(f"{len(fens)} positions")
+
+    for engine in args.engine:
+        quantized = engine_evals(engine, fens)
+        error = np.abs(quantized - reference)
+        print(f"\n{engine}")
+        print(f"  max error  {error.max():.2f} cp")
+        print(f"  mean error {error.mean():.3f} cp")
+        for i in np.argsort(-error)[:args.top]:
+            print(f"  {error[i]:8.2f}  engine {int(quantized[i]):6d}  float {reference[i]:9.2f}  {fens[i]}")
+        bench = subprocess.run([engine, "nnuebench", str(args.bench_iterations)],
+                               capture_output=True, text=True, check=True)
+        print("  " + bench.stdout.strip().replace("\n", "\n  "))
+
+
+if __name__ == "__main__":
+    main()
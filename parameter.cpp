@@ -1,9 +1,11 @@
 #include "parameter.hpp"
+#include <cmath>
 
 int KILLER_MOVE_BONUS = 10715;
 int COUNTER_HISTORY_BONUS = 6001;
 int FOLLOW_UP_BONUS = 3504;
-// int DELTA_MARGIN = 800;
+int DELTA_MARGIN = 200;
+int QS_SEE_MARGIN = 0;
 // int DELTA_INIT = 200;
 int RFP_MARGIN = 52;
 int FP_BASE = 244;
@@ -12,6 +14,8 @@ int WINDOW_INIT = 7;
 int WINDOW_MULT = 2;
 int SEE_MULTIPLIER = 74;
 double HISTORY_AGE_FACTOR = 1.1;
+double HISTORY_MOVE_AGE_FACTOR = 2.0;
+int KEEP_HEURISTICS = 1;
 int RFP_DEPTH = 4;
 int TT_PROBE_MIN_DEPTH = 1;
 int NMP_BASE = 3;
@@ -28,11 +32,30 @@ double LMR_BASE = 0.75;
 double LMR_DIV = 1.30;
 int LMR_HIST_MAX = 2;
 int LMR_HIST_DIV = 4224;
+int IIR_DEPTH = 3;
+int PROBCUT_DEPTH = 5;
+int PROBCUT_MARGIN = 200;
+int PROBCUT_REDUCTION = 4;
 int PROMOTE = 78490;
 int CASTLE = 3737;
 int EP_VAL = 9261;
 int CAPTURE = 70305;
 
+int LMR_TABLE[LMR_MAX_DEPTH][LMR_MAX_MOVES];
+
+void initLMRTable() {
+    for (int depth = 1; depth < LMR_MAX_DEPTH; depth++) {
+        for (int moves = 1; moves < LMR_MAX_MOVES; moves++) {
+            LMR_TABLE[depth][moves] = static_cast<int>(
+                (LMR_BASE +
+                 int(std::log(depth) * std::log(moves) / LMR_DIV)) *
+                LMR_ONE);
+        }
+    }
+}
+
+static const bool lmrTableReady = (initLMRTable(), true);
+
 void setValueFromCommand(const std::string &command) {
     std::istringstream iss(command);
     std::string cmd, name;
@@ -65,6 +88,10 @@ void setValueFromCommand(const std::string &command) {
         FOLLOW_UP_BONUS = static_cast<int>(value);
     else if (name == "HISTORY_AGE_FACTOR")
         HISTORY_AGE_FACTOR = value;
+    else if (name == "HISTORY_MOVE_AGE_FACTOR")
+        HISTORY_MOVE_AGE_FACTOR = value;
+    else if (name == "KEEP_HEURISTICS")
+        KEEP_HEURISTICS = static_cast<int>(value);
     else if (name == "RFP_DEPTH")
         RFP_DEPTH = static_cast<int>(value);
     else if (name == "TT_PROBE_MIN_DEPTH")
@@ -89,14 +116,29 @@ void setValueFromCommand(const std::string &command) {
         LMP_SCALE = static_cast<int>(value);
     else if (name == "LMR_DEPTH_MIN")
         LMR_DEPTH_MIN = static_cast<int>(value);
-    else if (name == "LMR_BASE")
-        LMR_BASE = static_cast<int>(value);
-    else if (name == "LMR_DIV")
-        LMR_DIV = static_cast<int>(value);
+    else if (name == "LMR_BASE") {
+        LMR_BASE = value;
+        initLMRTable();
+    } else if (name == "LMR_DIV") {
+        LMR_DIV = value;
+        initLMRTable();
+    }
     else if (name == "LMR_HIST_MAX")
         LMR_HIST_MAX = static_cast<int>(value);
     else if (name == "LMR_HIST_DIV")
         LMR_HIST_DIV = static_cast<int>(value);
+    else if (name == "IIR_DEPTH")
+        IIR_DEPTH = static_cast<int>(value);
+    else if (name == "DELTA_MARGIN")
+        DELTA_MARGIN = static_cast<int>(value);
+    else if (name == "QS_SEE_MARGIN")
+        QS_SEE_MARGIN = static_cast<int>(value);
+    else if (name == "PROBCUT_DEPTH")
+        PROBCUT_DEPTH = static_cast<int>(value);
+    else if (name == "PROBCUT_MARGIN")
+        PROBCUT_MARGIN = static_cast<int>(value);
+    else if (name == "PROBCUT_REDUCTION")
+        PROBCUT_REDUCTION = static_cast<int>(value);
     else if (name == "PROMOTE")
         PROMOTE = static_cast<int>(value);
     else if (name == "CASTLE")
@@ -134,6 +176,10 @@ void printUCIOptions() {
               << " min 0 max 10\n";
     std::cout << "option name HISTORY_AGE_FACTOR type string default "
               << HISTORY_AGE_FACTOR << "\n";
+    std::cout << "option name HISTORY_MOVE_AGE_FACTOR type string default "
+              << HISTORY_MOVE_AGE_FACTOR << "\n";
+    std::cout << "option name KEEP_HEURISTICS type spin default "
+              << KEEP_HEURISTICS << " min 0 max 1\n";
     std::cout << "option name RFP_DEPTH type spin default " << RFP_DEPTH
               << " min 0 max 20\n";
     std::cout << "option name TT_PROBE_MIN_DEPTH type spin default "
@@ -165,6 +211,18 @@ void printUCIOptions() {
               << " min 0 max 20\n";
     std::cout << "option name LMR_HIST_DIV type spin default " << LMR_HIST_DIV
               << " min 1 max 10000\n";
+    std::cout << "option name IIR_DEPTH type spin default " << IIR_DEPTH
+              << " min 1 max 100\n";
+    std::cout << "option name DELTA_MARGIN type spin default " << DELTA_MARGIN
+              << " min 0 max 2000\n";
+    std::cout << "option name QS_SEE_MARGIN type spin default " << QS_SEE_MARGIN
+              << " min 0 max 1000\n";
+    std::cout << "option name PROBCUT_DEPTH type spin default " << PROBCUT_DEPTH
+              << " min 1 max 100\n";
+    std::cout << "option name PROBCUT_MARGIN type spin default "
+              << PROBCUT_MARGIN << " min 0 max 2000\n";
+    std::cout << "option name PROBCUT_REDUCTION type spin default "
+              << PROBCUT_REDUCTION << " min 1 max 20\n";
     std::cout << "option name PROMOTE type spin default " << PROMOTE
               << " min 0 max 1000000\n";
     std::cout << "option name CASTLE type spin default " << CASTLE
@@ -1,3 +1,4 @@
+#pragma once
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -6,7 +7,8 @@ extern int COUNTER_HISTORY_BONUS;
 extern int FOLLOW_UP_BONUS;
 extern int KILLER_MOVE_BONUS;
 extern int SEE_MULTIPLIER;
-//extern int DELTA_MARGIN;
+extern int DELTA_MARGIN;
+extern int QS_SEE_MARGIN;
 //extern int DELTA_INIT;
 extern int RFP_MARGIN;
 extern int FP_BASE;
@@ -14,6 +16,8 @@ extern int FP_ADD;
 extern int WINDOW_INIT;
 extern int WINDOW_MULT;
 extern double HISTORY_AGE_FACTOR;
+extern double HISTORY_MOVE_AGE_FACTOR;
+extern int KEEP_HEURISTICS;
 extern int RFP_DEPTH;
 extern int TT_PROBE_MIN_DEPTH;
 extern int NMP_BASE;
@@ -30,9 +34,21 @@ extern double LMR_BASE;
 extern double LMR_DIV;
 extern int LMR_HIST_MAX;
 extern int LMR_HIST_DIV;
+extern int IIR_DEPTH;
+extern int PROBCUT_DEPTH;
+extern int PROBCUT_MARGIN;
+extern int PROBCUT_REDUCTION;
 extern int PROMOTE ;
 extern int CASTLE ;
 extern int EP_VAL ;
 extern int CAPTURE ;
+
+// Base late move reduction by [depth][quiet move number], from LMR_BASE and
+// LMR_DIV, in 1/LMR_ONE plies. Rebuilt when either is set.
+constexpr int LMR_ONE = 1024;
+constexpr int LMR_MAX_DEPTH = 128;
+constexpr int LMR_MAX_MOVES = 256;
+extern int LMR_TABLE[LMR_MAX_DEPTH][LMR_MAX_MOVES];
+void initLMRTable();
 void setValueFromCommand(const std::string& command);
 void printUCIOptions();
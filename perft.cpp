@@ -0,0 +1,344 @@
+#include "perft.hpp"
+#include "movegen.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static int childEP(EncodedMove move) noexcept {
+    if (moveKind(move) == MoveKind::DoublePush) {
+        return (moveFrom(move) + moveTo(move)) / 2;
+    }
+    return -1;
+}
+
+static std::string moveToUCI(EncodedMove move) {
+    std::string uci = convertToUCI(moveFrom(move)) + convertToUCI(moveTo(move));
+    if (isPromotion(move)) {
+        uci += "qrbn"[movePromotion(move)];
+    }
+    return uci;
+}
+
+// Piece keys are shared with create_hash; castling and the en passant file
+// only matter to perft, so they get their own keys from a different seed.
+static constexpr auto perftKeys = gen_random_keys(0x9e3779b97f4a7c15ULL);
+
+static uint64_t perftKey(const Board &brd, const BoardState &state,
+                         int ep) noexcept {
+    const uint64_t pieces[12] = {brd.WPawn, brd.WKnight, brd.WBishop,
+                                 brd.WRook, brd.WQueen,  brd.WKing,
+                                 brd.BPawn, brd.BKnight, brd.BBishop,
+                                 brd.BRook, brd.BQueen,  brd.BKing};
+    uint64_t key = state.IsWhite ? random_key[768] : 0;
+    for (int p = 0; p < 12; p++) {
+        uint64_t bb = pieces[p];
+        Bitloop(bb) { key ^= random_key[p * 64 + __builtin_ctzll(bb)]; }
+    }
+    key ^= perftKeys[brd.castlingRights()];
+    if (ep != -1) {
+        key ^= perftKeys[16 + (ep & 7)];
+    }
+    return key;
+}
+
+// Lockless shared table: the check word is key ^ data, so an entry torn by
+// a concurrent write fails verification instead of returning a bad count.
+struct PerftEntry {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data; // count << 8 | depth
+};
+
+// Two entries per 32 byte bucket: the first keeps the deepest subtree seen
+// for the slot, the second is always replaced.
+struct alignas(32) PerftBucket {
+    PerftEntry deep;
+    PerftEntry recent;
+};
+
+class PerftTable {
+  public:
+    explicit PerftTable(int megabytes) {
+        uint64_t buckets = (uint64_t)megabytes * 1024 * 1024 / sizeof(PerftBucket);
+        size = 1;
+        while (size * 2 <= buckets) {
+            size *= 2;
+        }
+        table = std::make_unique<PerftBucket[]>(size);
+    }
+
+    bool probe(uint64_t key, int depth, uint64_t &count) const noexcept {
+        const PerftBucket &b = table[key & (size - 1)];
+        return read(b.deep, key, depth, count) ||
+               read(b.recent, key, depth, count);
+    }
+
+    void store(uint64_t key, int depth, uint64_t count) noexcept {
+        PerftBucket &b = table[key & (size - 1)];
+        uint64_t data = count << 8 | depth;
+        bool deeper =
+            depth >= (int)(b.deep.data.load(std::memory_order_relaxed) & 0xFF);
+        PerftEntry &e = deeper ? b.deep : b.recent;
+        e.check.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+
+  private:
+    static bool read(const PerftEntry &e, uint64_t key, int depth,
+                     uint64_t &count) noexcept {
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        uint64_t check = e.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || (int)(data & 0xFF) != depth) {
+            return false;
+        }
+        count = data >> 8;
+        return true;
+    }
+
+    uint64_t size;
+    std::unique_ptr<PerftBucket[]> table;
+};
+
+template <bool hashed>
+static uint64_t perftNode(const Board &brd, const BoardState &state, int ep,
+                          int depth, PerftTable *table);
+
+template <class BoardState status, bool hashed>
+static uint64_t perftMoves(const Board &brd, int ep, int depth,
+                           PerftTable *table) {
+    MoveList ml;
+    genMoves<status, 0, MoveGen::All>(brd, ep, ml);
+    if (depth == 1) {
+        return ml.count;
+    }
+    uint64_t key = 0;
+    if constexpr (hashed) {
+        uint64_t cached;
+        key = perftKey(brd, status, ep);
+        if (table->probe(key, depth, cached)) {
+            return cached;
+        }
+    }
+    uint64_t nodes = 0;
+    for (int i = 0; i < ml.count; i++) {
+        MoveResult res = makeMove<status>(brd, ml.moves[i]);
+        nodes += perftNode<hashed>(res.board, res.state, childEP(ml.moves[i]),
+                                   depth - 1, table);
+    }
+    if constexpr (hashed) {
+        table->store(key, depth, nodes);
+    }
+    return nodes;
+}
+
+// One dispatch on the state per node; generation and every make below it
+// are then resolved at compile time.
+template <bool hashed>
+static uint64_t perftNode(const Board &brd, const BoardState &state, int ep,
+                          int depth, PerftTable *table) {
+    if (depth == 0) {
+        return 1;
+    }
+    return stateCall(state.IsWhite, state.EP, state.WLC, state.WRC, state.BLC,
+                     state.BRC, [&]<BoardState status>() {
+                         return perftMoves<status, hashed>(brd, ep, depth,
+                                                           table);
+                     });
+}
+
+uint64_t perft(const Board &brd, const BoardState &state, int ep, int depth) {
+    return perftNode<false>(brd, state, ep, depth, nullptr);
+}
+
+static uint64_t perftParallel(const Board &brd, const BoardState &state,
+                              int ep, int depth, bool divide, int threads,
+                              PerftTable *table) {
+    // divide always splits the root, even at depth 1, to print every move.
+    if (depth <= 0 || (!divide && (depth == 1 || (threads <= 1 && !table)))) {
+        return perft(brd, state, ep, depth);
+    }
+
+    MoveList ml;
+    moveGenCall<0, MoveGen::All>(brd, ep, ml, state.IsWhite, state.EP,
+                                 state.WLC, state.WRC, state.BLC, state.BRC);
+    const int count = ml.count;
+    std::vector<uint64_t> counts(count);
+    std::atomic<int> next = 0;
+    auto worker = [&] {
+        for (int i = next++; i < count; i = next++) {
+            MoveResult res = makeMove(brd, state, ml.moves[i]);
+            int childEp = childEP(ml.moves[i]);
+            counts[i] = table ? perftNode<true>(res.board, res.state, childEp,
+                                                depth - 1, table)
+                              : perft(res.board, res.state, childEp, depth - 1);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < count; i++) {
+        if (divide) {
+            printf("%s: %lu\n", moveToUCI(ml.moves[i]).c_str(), counts[i]);
+        }
+        nodes += counts[i];
+    }
+    return nodes;
+}
+
+uint64_t perftDivide(const Board &brd, const BoardState &state, int ep,
+                     int depth, bool divide, int threads, int hashMB) {
+    std::unique_ptr<PerftTable> table;
+    if (hashMB > 0) {
+        table = std::make_unique<PerftTable>(hashMB);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    uint64_t nodes =
+        perftParallel(brd, state, ep, depth, divide, threads, table.get());
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+    printf("\nNodes searched: %lu\n", nodes);
+    printf("time %d ms nps %.0f\n", (int)(1000 * duration.count()),
+           nodes / std::max(duration.count(), 1e-9));
+    fflush(stdout);
+    return nodes;
+}
+
+struct PerftCase {
+    const char *fen;
+    int depth;
+    uint64_t nodes;
+};
+
+// Published counts from the chessprogramming wiki and the perft debugging
+// positions collected on talkchess (pins, en passant, castling, promotions).
+static const PerftCase perftCases[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+    {"r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 5, 15833292},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194},
+    {"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+    {"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+    {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+    {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+    {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+    {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+    {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+    {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+    {"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+    {"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+    {"8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+    {"K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+    {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+    {"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+// Every case gets a fresh table, allocated outside the timed region, so
+// the reported speedup does not include hits carried over from earlier cases.
+static double timedPerft(const PerftCase &c, int threads, int hashMB,
+                         uint64_t &nodes) {
+    Board brd = loadFenBoard(c.fen);
+    BoardState state = parseBoardState(c.fen);
+    std::unique_ptr<PerftTable> table;
+    if (hashMB > 0) {
+        table = std::make_unique<PerftTable>(hashMB);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    nodes = perftParallel(brd, state, parseEnPassantSquare(c.fen), c.depth,
+                          false, threads, table.get());
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+    return duration.count();
+}
+
+int runPerftSuite(int maxDepth, int threads, int hashMB) {
+    const bool compare = threads > 1 || hashMB > 0;
+    int failures = 0;
+    uint64_t totalNodes = 0;
+    double totalTime = 0, totalBaseline = 0;
+    for (const PerftCase &c : perftCases) {
+        if (c.depth > maxDepth) {
+            continue;
+        }
+        uint64_t nodes;
+        double time = timedPerft(c, threads, hashMB, nodes);
+        totalNodes += nodes;
+        totalTime += time;
+        bool ok = nodes == c.nodes;
+        failures += !ok;
+        printf("%-4s depth %d %12lu %12lu %7d ms", ok ? "ok" : "FAIL", c.depth,
+               nodes, c.nodes, (int)(1000 * time));
+        if (compare) {
+            uint64_t baselineNodes;
+            double baseline = timedPerft(c, 1, 0, baselineNodes);
+            totalBaseline += baseline;
+            printf(" %7d ms %5.1fx", (int)(1000 * baseline), baseline / time);
+        }
+        printf("  %s\n", c.fen);
+        fflush(stdout);
+    }
+    printf("%d failures, %lu nodes, %d ms, %.0f nps\n", failures, totalNodes,
+           (int)(1000 * totalTime), totalNodes / std::max(totalTime, 1e-9));
+    if (compare) {
+        printf("%d threads, %d MB hash: %.1fx faster than plain perft "
+               "(%d ms)\n",
+               threads, hashMB, totalBaseline / totalTime,
+               (int)(1000 * totalBaseline));
+    }
+    return failures;
+}
+
+static const char *boardLayoutName() {
+#if defined(BOARD_PACKED)
+    return "packed";
+#else
+    return "plain";
+#endif
+}
+
+int runMakeBench(int iterations) {
+    uint64_t made = 0, sink = 0;
+    double time = 0;
+    for (const PerftCase &c : perftCases) {
+        const Board brd = loadFenBoard(c.fen);
+        const BoardState state = parseBoardState(c.fen);
+        MoveList ml;
+        ml.count = 0;
+        stateCall(state.IsWhite, state.EP, state.WLC, state.WRC, state.BLC,
+                  state.BRC, [&]<BoardState status>() {
+                      genMoves<status, 0, MoveGen::All>(
+                          brd, parseEnPassantSquare(c.fen), ml);
+                  });
+        auto start = std::chrono::high_resolution_clock::now();
+        stateCall(state.IsWhite, state.EP, state.WLC, state.WRC, state.BLC,
+                  state.BRC, [&]<BoardState status>() {
+                      for (int i = 0; i < iterations; i++) {
+                          for (int m = 0; m < ml.count; m++) {
+                              const Board child =
+                                  makeMove<status>(brd, ml.moves[m]).board;
+                              sink += child.Occ ^ child.White ^ child.WPawn ^
+                                      child.BQueen;
+                          }
+                      }
+                  });
+        auto end = std::chrono::high_resolution_clock::now();
+        time += std::chrono::duration<double>(end - start).count();
+        made += (uint64_t)iterations * ml.count;
+    }
+    printf("board %s, %lu moves made, %d ms, %.1f M moves/s (%lx)\n",
+           boardLayoutName(), made, (int)(1000 * time),
+           made / std::max(time, 1e-9) / 1e6, sink);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "board.hpp"
+#include <cstdint>
+#include <string>
+
+// Counts leaf nodes of the legal move tree using the make path of genMoves.
+// The last ply is bulk counted: moves are generated but never made.
+uint64_t perft(const Board &brd, const BoardState &state, int ep, int depth);
+
+// Splits the root moves over `threads` workers that share a (key, depth) ->
+// count table of `hashMB` megabytes. threads = 1 and hashMB = 0 is plain
+// perft. Prints the subtree count of every root move when `divide` is set,
+// then the total and nodes/second.
+uint64_t perftDivide(const Board &brd, const BoardState &state, int ep,
+                     int depth, bool divide, int threads = 1, int hashMB = 0);
+
+// Runs the standard perft positions against their published counts. With
+// more than one thread or a hash table every case is also timed as plain
+// perft and the speedup is reported. Returns the number of mismatches.
+int runPerftSuite(int maxDepth, int threads = 1, int hashMB = 0);
+
+// Times makeMove over every legal move of the perft positions, to compare
+// the board layouts (cmake -DBOARD=PLAIN/PACKED) without move generation
+// in the way.
+int runMakeBench(int iterations);
@@ -0,0 +1,99 @@
+#pragma once
+#include "constants.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+// Cuckoo table of every reversible move on an empty board, keyed by the
+// hash difference it makes (both piece squares and the side to move). A
+// key sits at one of its two slots, so a lookup is two probes.
+constexpr int CUCKOO_SIZE = 8192;
+extern const std::array<uint64_t, CUCKOO_SIZE> cuckooKeys;
+// from | to << 6 of the move stored at the same slot.
+extern const std::array<uint16_t, CUCKOO_SIZE> cuckooMoves;
+
+__inline int cuckooSlot1(uint64_t key) noexcept { return key & 0x1FFF; }
+__inline int cuckooSlot2(uint64_t key) noexcept { return (key >> 16) & 0x1FFF; }
+
+// Most plies of game history a search is seeded with. Anything older is
+// beyond the fifty move rule.
+constexpr int REPETITION_HISTORY = 128;
+// Most plies the search itself can push.
+constexpr int REPETITION_SEARCH = 1024;
+
+// Keys of the positions from the game's last irreversible move down to the
+// node being searched. Each search thread owns one, so nodes only push and
+// pop an index and nothing is allocated.
+struct RepetitionStack {
+    uint64_t keys[REPETITION_HISTORY + REPETITION_SEARCH];
+    int count = 0;
+
+    // Takes the reversible tail of the game, ending with the root.
+    void seed(const uint64_t *history, int size, int irreversibleCount,
+              uint64_t rootKey) noexcept {
+        if (size > 0 && history[size - 1] == rootKey) {
+            size--;
+        }
+        const int take =
+            std::min({size, irreversibleCount, REPETITION_HISTORY - 1});
+        count = 0;
+        for (int i = size - take; i < size; i++) {
+            keys[count++] = history[i];
+        }
+        keys[count++] = rootKey;
+    }
+
+    void push(uint64_t key) noexcept {
+        assert(count < REPETITION_HISTORY + REPETITION_SEARCH);
+        keys[count++] = key;
+    }
+
+    void pop() noexcept { count--; }
+
+    // Whether the top key occurs earlier within the last `plies` plies, the
+    // ones since the last irreversible or null move. Only positions with the same side to move can match, and the
+    // nearest of those that can is four plies back.
+    bool repeated(int plies) const noexcept {
+        const uint64_t key = keys[count - 1];
+        const int stop = std::max(0, count - 1 - plies);
+        for (int i = count - 5; i >= stop; i -= 2) {
+            if (keys[i] == key) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether the side to move has a reversible move back to a position
+    // within the last `plies` plies. The hash difference names the move;
+    // it only has to have a clear path and be made by a piece of ours (on
+    // from, or on to if from is empty).
+    bool upcoming(uint64_t occ, uint64_t own, int plies) const noexcept {
+        const uint64_t key = keys[count - 1];
+        const int stop = std::max(0, count - 1 - plies);
+        for (int i = count - 4; i >= stop; i -= 2) {
+            const uint64_t diff = key ^ keys[i];
+            int slot = cuckooSlot1(diff);
+            if (cuckooKeys[slot] != diff) {
+                slot = cuckooSlot2(diff);
+                if (cuckooKeys[slot] != diff) {
+                    continue;
+                }
+            }
+            const int from = cuckooMoves[slot] & 63;
+            const int to = cuckooMoves[slot] >> 6;
+            if (kingPath[64 * from + to] & ~(1ULL << to) & occ) {
+                continue;
+            }
+            const uint64_t mover =
+                occ & (1ULL << from) ? 1ULL << from : 1ULL << to;
+            if (own & mover) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+inline thread_local RepetitionStack repetitions;
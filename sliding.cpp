@@ -4,6 +4,9 @@
 #include <bit>
 #include <cmath>
 #include <array>
+#include <chrono>
+#include <cstdio>
+#include <vector>
 #include "constants.hpp"
 
 constexpr uint64_t set_occupancy(int index, int bits_in_mask, uint64_t attack_mask) {
@@ -127,6 +130,8 @@ constexpr uint64_t RC(uint64_t occ, int square) {
 const std::array<uint64_t,64> r_mask = init_rmask();
 const std::array<uint64_t, 64> b_mask = init_bmask();
 
+#if defined(SLIDERS_PLAIN)
+
 constexpr std::array<std::array<uint64_t, 4096>, 64> r_magic_init() {
     std::array<std::array<uint64_t, 4096>, 64> r_indexs{};
     for (int i = 0; i < 64; i++) {
@@ -167,4 +172,113 @@ constexpr std::array<std::array<uint64_t, 512>, 64> b_magic_init() {
 const std::array<std::array<uint64_t, 4096>, 64> r_indexs = r_magic_init();
 const std::array<std::array<uint64_t, 512>, 64> b_indexs = b_magic_init();
 
+const char *sliders_name() { return "plain magics"; }
+
+#else
+
+constexpr std::array<SliderSquare, 64>
+slider_squares_init(const std::array<uint64_t, 64> &mask,
+                    const uint64_t *magics, const uint8_t *bits,
+                    uint32_t offset) {
+    std::array<SliderSquare, 64> squares{};
+    for (int i = 0; i < 64; i++) {
+        squares[i] = {mask[i], magics[i], offset, 64u - bits[i]};
+        offset += 1u << bits[i];
+    }
+    return squares;
+}
+
+// Rook entries first, bishops behind them.
+const std::array<SliderSquare, 64> r_squares =
+    slider_squares_init(r_mask, Rmagics, RBn, 0);
+const std::array<SliderSquare, 64> b_squares =
+    slider_squares_init(b_mask, Bmagics, BBn, 102400);
+
+constexpr uint32_t slider_index(const SliderSquare &sq, int subset,
+                                uint64_t occ) {
+#if defined(SLIDERS_PEXT)
+    // set_occupancy deposits the bits of subset into the mask in square
+    // order, which is exactly what pext gathers back.
+    return sq.offset + subset;
+#else
+    return sq.offset + ((occ * sq.magic) >> sq.shift);
+#endif
+}
+
+constexpr std::array<uint64_t, SLIDER_TABLE_SIZE> slider_attacks_init() {
+    std::array<uint64_t, SLIDER_TABLE_SIZE> table{};
+    for (int i = 0; i < 64; i++) {
+        int r_count = std::popcount(r_mask[i]);
+        for (int j = 0; j < 1 << r_count; j++) {
+            uint64_t occ = set_occupancy(j, r_count, r_mask[i]);
+            table[slider_index(r_squares[i], j, occ)] = RC(occ, i);
+        }
+        int b_count = std::popcount(b_mask[i]);
+        for (int j = 0; j < 1 << b_count; j++) {
+            uint64_t occ = set_occupancy(j, b_count, b_mask[i]);
+            table[slider_index(b_squares[i], j, occ)] = BC(occ, i);
+        }
+    }
+    return table;
+}
+
+const std::array<uint64_t, SLIDER_TABLE_SIZE> slider_attacks =
+    slider_attacks_init();
+
+const char *sliders_name() {
+#if defined(SLIDERS_PEXT)
+    return "pext";
+#else
+    return "fancy magics";
+#endif
+}
+
+#endif
 
+int sliders_bench(int iterations) {
+    constexpr int SAMPLES = 4096;
+    std::vector<int> squares(SAMPLES);
+    std::vector<uint64_t> occs(SAMPLES);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    auto next = [&] {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+    // Roughly a middlegame density of blockers.
+    for (int i = 0; i < SAMPLES; i++) {
+        squares[i] = next() & 63;
+        occs[i] = next() & next();
+    }
+
+    int errors = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        errors += getRmagic(squares[i], occs[i]) != RC(occs[i], squares[i]);
+        errors += getBmagic(squares[i], occs[i]) != BC(occs[i], squares[i]);
+    }
+
+#if defined(SLIDERS_PLAIN)
+    size_t bytes = sizeof(r_indexs) + sizeof(b_indexs);
+#else
+    size_t bytes = sizeof(slider_attacks) + sizeof(r_squares) + sizeof(b_squares);
+#endif
+    printf("sliders %s, %zu KB of tables, %d wrong lookups\n", sliders_name(),
+           bytes / 1024, errors);
+
+    uint64_t sink = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        int k = i & (SAMPLES - 1);
+        // Feed the result back into the occupancy so the lookups are
+        // latency bound, like a move generator walking a board.
+        uint64_t occ = occs[k] ^ (sink & 1);
+        sink += getRmagic(squares[k], occ) + getBmagic(squares[k], occ);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+    printf("%-12s %12.0f per s %9.2f ns (sink %llx)\n", "rook+bishop",
+           iterations / duration.count(), duration.count() * 1e9 / iterations,
+           (unsigned long long)sink);
+    return errors;
+}
@@ -4,10 +4,27 @@
 #include <cmath>
 #include <array>
 #include "constants.hpp"
+#if defined(SLIDERS_PEXT)
+#include <immintrin.h>
+#endif
+
+// Slider attack backend, picked at build time (cmake -DSLIDERS=...):
+//   SLIDERS_PEXT   index by _pext_u64 of the occupancy, needs BMI2
+//   SLIDERS_FANCY  index by the magics in constants.hpp
+//   SLIDERS_PLAIN  magics into fixed 4096/512 entry rows per square
+// PEXT and FANCY share one packed table of 107648 entries (~840 KB), PLAIN
+// uses ~2.3 MB.
+#if !defined(SLIDERS_PEXT) && !defined(SLIDERS_FANCY) && !defined(SLIDERS_PLAIN)
+#define SLIDERS_FANCY
+#endif
+#if defined(SLIDERS_PEXT) && !defined(__BMI2__)
+#error "SLIDERS_PEXT needs a BMI2 target (-mbmi2)"
+#endif
 
 extern const std::array<uint64_t,64> r_mask;
 extern const std::array<uint64_t, 64> b_mask;
 
+#if defined(SLIDERS_PLAIN)
 
 extern const std::array<std::array<uint64_t, 4096>, 64> r_indexs;
 extern const std::array<std::array<uint64_t, 512>, 64> b_indexs;
@@ -20,13 +37,56 @@ __inline uint64_t getRmagic(int square,uint64_t occ) noexcept {
 }
 
 __inline uint64_t getBmagic(int square,uint64_t occ) noexcept {
-    uint64_t occCopy= occ;
     occ &= b_mask[square];
     occ *= Bmagics[square];
     occ >>= (64ULL - BBn[square]);
     return b_indexs[square][occ];
 }
 
+#else
+
+// Everything one lookup needs, so it touches a single line besides the
+// attack table itself.
+struct SliderSquare {
+    uint64_t mask;
+    uint64_t magic;
+    uint32_t offset;
+    uint32_t shift;
+};
+
+constexpr int SLIDER_TABLE_SIZE = 102400 + 5248;
+
+extern const std::array<SliderSquare, 64> r_squares;
+extern const std::array<SliderSquare, 64> b_squares;
+extern const std::array<uint64_t, SLIDER_TABLE_SIZE> slider_attacks;
+
+__inline uint64_t sliderAttacks(const SliderSquare &sq, uint64_t occ) noexcept {
+#if defined(SLIDERS_PEXT)
+    return slider_attacks[sq.offset + _pext_u64(occ, sq.mask)];
+#else
+    return slider_attacks[sq.offset +
+                          (((occ & sq.mask) * sq.magic) >> sq.shift)];
+#endif
+}
+
+__inline uint64_t getRmagic(int square,uint64_t occ) noexcept {
+    return sliderAttacks(r_squares[square], occ);
+}
+
+__inline uint64_t getBmagic(int square,uint64_t occ) noexcept {
+    return sliderAttacks(b_squares[square], occ);
+}
+
+#endif
+
 __inline uint64_t getQmagic(int square,uint64_t occ) noexcept {
     return getRmagic(square,occ) | getBmagic(square,occ);
 }
+
+// Name of the compiled backend.
+const char *sliders_name();
+
+// Checks the compiled backend against a ray walk and times random rook and
+// bishop lookups. Build with -DSLIDERS=PLAIN/FANCY/PEXT to compare.
+// Returns the number of wrong lookups.
+int sliders_bench(int iterations);
@@ -0,0 +1,499 @@
+#include "train.hpp"
+#include "board.hpp"
+#include "nnue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define INPUT_SIZE 768
+#define EVAL_SCALE 400.0f
+// Engine quantization, see nnue_evaluate: accumulators are scaled by QA,
+// output weights by QB and the output bias by QA * QB.
+#define QA 256
+#define QB 64
+
+struct TrainingPosition {
+    uint64_t occ;
+    uint8_t pieces[16]; // 4 bits per occupied square, color * 6 + type
+    int16_t score;      // white relative centipawns
+    uint8_t result;     // white relative: 0 loss, 1 draw, 2 win
+    uint8_t isWhite;
+};
+
+struct TrainConfig {
+    std::string data;
+    std::string out = "network_weights.hpp";
+    std::string checkpoint = "nnue_train.ckpt";
+    bool resume = false;
+    int epochs = 20;
+    int batchSize = 16384;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    float lr = 0.001f;
+    float lrDecay = 0.92f;
+    float lambda = 0.5f; // weight of the eval target against the game result
+    float validation = 0.01f;
+    size_t maxPositions = SIZE_MAX;
+};
+
+// All parameters live in one float array so gradients, Adam moments and
+// checkpoints can treat them uniformly.
+constexpr size_t FT_WEIGHTS = 0;
+constexpr size_t FT_BIAS = FT_WEIGHTS + INPUT_SIZE * HL_SIZE;
+constexpr size_t OUT_WEIGHTS = FT_BIAS + HL_SIZE; // stm half, then non-stm
+constexpr size_t OUT_BIAS = OUT_WEIGHTS + 2 * HL_SIZE;
+constexpr size_t PARAM_COUNT = OUT_BIAS + 1;
+
+// The output layer is trained in sigmoid units (centipawns / EVAL_SCALE).
+// These are the largest values that still quantize into the engine's int16
+// fields; output weights stay within the +-127 the shipped nets use.
+constexpr float FT_LIMIT = 32767.0f / QA;
+constexpr float OUT_LIMIT = 127.0f * QA / QB / EVAL_SCALE;
+constexpr float BIAS_LIMIT = 32767.0f / (QA * QB) / EVAL_SCALE;
+
+static bool parsePosition(const std::string &line, TrainingPosition &pos) {
+    size_t bar1 = line.find('|');
+    size_t bar2 = line.find('|', bar1 + 1);
+    if (bar1 == std::string::npos || bar2 == std::string::npos) {
+        return false;
+    }
+    std::string fen = line.substr(0, bar1);
+    size_t space = fen.find(' ');
+    if (space == std::string::npos) {
+        return false;
+    }
+
+    uint8_t squares[64];
+    memset(squares, 0xFF, sizeof(squares));
+    int rank = 7;
+    int file = 0;
+    for (size_t i = 0; i < space; i++) {
+        char c = fen[i];
+        if (c == '/') {
+            rank--;
+            file = 0;
+        } else if (isdigit(c)) {
+            file += c - '0';
+        } else {
+            const char *types = "pnbrqk";
+            const char *type = strchr(types, tolower(c));
+            if (type == nullptr || rank < 0 || file > 7) {
+                return false;
+            }
+            squares[rank * 8 + file] = (isupper(c) ? 6 : 0) + (type - types);
+            file++;
+        }
+    }
+
+    pos.occ = 0;
+    memset(pos.pieces, 0, sizeof(pos.pieces));
+    int count = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (squares[sq] == 0xFF) {
+            continue;
+        }
+        if (count == 32) {
+            return false;
+        }
+        pos.occ |= 1ULL << sq;
+        pos.pieces[count / 2] |= squares[sq] << (4 * (count & 1));
+        count++;
+    }
+    pos.isWhite = fen[space + 1] == 'w';
+    try {
+        pos.score = std::clamp(std::stoi(line.substr(bar1 + 1)), -32000, 32000);
+        pos.result = (uint8_t)std::lround(std::stod(line.substr(bar2 + 1)) * 2.0);
+    } catch (...) {
+        return false;
+    }
+    return pos.result <= 2;
+}
+
+// Feature rows for the side to move and the other side, in engine indexing.
+static int positionFeatures(const TrainingPosition &pos, int *stm, int *nstm) {
+    uint64_t occ = pos.occ;
+    int count = 0;
+    Bitloop(occ) {
+        const int sq = __builtin_ctzll(occ);
+        const int piece = (pos.pieces[count / 2] >> (4 * (count & 1))) & 0xF;
+        const int color = piece >= 6;
+        stm[count] = calculate_idx(piece % 6, color, sq, pos.isWhite);
+        nstm[count] = calculate_idx(piece % 6, color, sq, !pos.isWhite);
+        count++;
+    }
+    return count;
+}
+
+static inline float sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+// Forward pass for one position; when grad is non-null also runs the
+// backward pass and accumulates into it. Returns the squared error.
+static float trainPosition(const float *__restrict params,
+                           float *__restrict grad, const TrainingPosition &pos,
+                           float lambda) {
+    alignas(64) float accStm[HL_SIZE];
+    alignas(64) float accNstm[HL_SIZE];
+    int stmIdx[32], nstmIdx[32];
+    const int count = positionFeatures(pos, stmIdx, nstmIdx);
+
+    const float *bias = params + FT_BIAS;
+    for (int i = 0; i < HL_SIZE; i++) {
+        accStm[i] = bias[i];
+        accNstm[i] = bias[i];
+    }
+    for (int f = 0; f < count; f++) {
+        const float *stmRow = params + FT_WEIGHTS + stmIdx[f] * HL_SIZE;
+        const float *nstmRow = params + FT_WEIGHTS + nstmIdx[f] * HL_SIZE;
+        for (int i = 0; i < HL_SIZE; i++) {
+            accStm[i] += stmRow[i];
+            accNstm[i] += nstmRow[i];
+        }
+    }
+
+    const float *outStm = params + OUT_WEIGHTS;
+    const float *outNstm = params + OUT_WEIGHTS + HL_SIZE;
+    float output = params[OUT_BIAS];
+    for (int i = 0; i < HL_SIZE; i++) {
+        const float s = std::clamp(accStm[i], 0.0f, 1.0f);
+        const float n = std::clamp(accNstm[i], 0.0f, 1.0f);
+        output += s * s * outStm[i] + n * n * outNstm[i];
+    }
+
+    const float score = pos.isWhite ? pos.score : -pos.score;
+    const float result = (pos.isWhite ? pos.result : 2 - pos.result) * 0.5f;
+    const float target =
+        lambda * sigmoid(score / EVAL_SCALE) + (1.0f - lambda) * result;
+    const float prediction = sigmoid(output);
+    const float error = prediction - target;
+    if (grad == nullptr) {
+        return error * error;
+    }
+
+    const float g = 2.0f * error * prediction * (1.0f - prediction);
+    grad[OUT_BIAS] += g;
+    float *gOutStm = grad + OUT_WEIGHTS;
+    float *gOutNstm = grad + OUT_WEIGHTS + HL_SIZE;
+    for (int i = 0; i < HL_SIZE; i++) {
+        const float s = std::clamp(accStm[i], 0.0f, 1.0f);
+        const float n = std::clamp(accNstm[i], 0.0f, 1.0f);
+        gOutStm[i] += g * s * s;
+        gOutNstm[i] += g * n * n;
+        // Reuse the accumulators for the gradient w.r.t. them.
+        accStm[i] = (accStm[i] > 0.0f && accStm[i] < 1.0f)
+                        ? g * outStm[i] * 2.0f * s
+                        : 0.0f;
+        accNstm[i] = (accNstm[i] > 0.0f && accNstm[i] < 1.0f)
+                         ? g * outNstm[i] * 2.0f * n
+                         : 0.0f;
+    }
+    float *gBias = grad + FT_BIAS;
+    for (int i = 0; i < HL_SIZE; i++) {
+        gBias[i] += accStm[i] + accNstm[i];
+    }
+    for (int f = 0; f < count; f++) {
+        float *stmRow = grad + FT_WEIGHTS + stmIdx[f] * HL_SIZE;
+        float *nstmRow = grad + FT_WEIGHTS + nstmIdx[f] * HL_SIZE;
+        for (int i = 0; i < HL_SIZE; i++) {
+            stmRow[i] += accStm[i];
+            nstmRow[i] += accNstm[i];
+        }
+    }
+    return error * error;
+}
+
+template <typename F> static void parallelFor(int threads, size_t n, F &&body) {
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        size_t begin = n * t / threads;
+        size_t end = n * (t + 1) / threads;
+        pool.emplace_back([&body, t, begin, end] { body(t, begin, end); });
+    }
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+struct Trainer {
+    TrainConfig cfg;
+    std::vector<float> params, m, v;
+    std::vector<std::vector<float>> grads; // one buffer per thread
+    int epoch = 0;
+    long step = 0;
+
+    explicit Trainer(const TrainConfig &config)
+        : cfg(config), params(PARAM_COUNT), m(PARAM_COUNT), v(PARAM_COUNT),
+          grads(config.threads, std::vector<float>(PARAM_COUNT)) {
+        std::mt19937 rng(20240607);
+        std::uniform_real_distribution<float> ft(-1.0f / std::sqrt(32.0f),
+                                                 1.0f / std::sqrt(32.0f));
+        std::uniform_real_distribution<float> out(-OUT_LIMIT, OUT_LIMIT);
+        for (size_t i = FT_WEIGHTS; i < FT_BIAS; i++) {
+            params[i] = ft(rng) * 0.1f;
+        }
+        for (size_t i = OUT_WEIGHTS; i < OUT_BIAS; i++) {
+            params[i] = out(rng);
+        }
+    }
+
+    double batch(const std::vector<TrainingPosition> &data,
+                 const std::vector<uint32_t> &order, size_t begin,
+                 size_t end) {
+        const int threads = cfg.threads;
+        std::vector<double> losses(threads);
+        parallelFor(threads, end - begin, [&](int t, size_t b, size_t e) {
+            std::fill(grads[t].begin(), grads[t].end(), 0.0f);
+            double loss = 0;
+            for (size_t i = begin + b; i < begin + e; i++) {
+                loss += trainPosition(params.data(), grads[t].data(),
+                                      data[order[i]], cfg.lambda);
+            }
+            losses[t] = loss;
+        });
+
+        step++;
+        const float beta1 = 0.9f, beta2 = 0.999f, eps = 1e-8f;
+        const float lr = cfg.lr * std::pow(cfg.lrDecay, (float)epoch);
+        const float correction1 = 1.0f - std::pow(beta1, (float)step);
+        const float correction2 = 1.0f - std::pow(beta2, (float)step);
+        const float scale = 1.0f / (end - begin);
+        parallelFor(threads, PARAM_COUNT, [&](int, size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                float g = 0;
+                for (int t = 0; t < threads; t++) {
+                    g += grads[t][i];
+                }
+                g *= scale;
+                m[i] = beta1 * m[i] + (1.0f - beta1) * g;
+                v[i] = beta2 * v[i] + (1.0f - beta2) * g * g;
+                params[i] -= lr * (m[i] / correction1) /
+                             (std::sqrt(v[i] / correction2) + eps);
+                const float limit = i < OUT_WEIGHTS ? FT_LIMIT
+                                    : i < OUT_BIAS    ? OUT_LIMIT
+                                                      : BIAS_LIMIT;
+                params[i] = std::clamp(params[i], -limit, limit);
+            }
+        });
+
+        double loss = 0;
+        for (double l : losses) {
+            loss += l;
+        }
+        return loss;
+    }
+
+    double validate(const std::vector<TrainingPosition> &data, size_t begin,
+                    size_t end) {
+        std::vector<double> losses(cfg.threads);
+        parallelFor(cfg.threads, end - begin, [&](int t, size_t b, size_t e) {
+            double loss = 0;
+            for (size_t i = begin + b; i < begin + e; i++) {
+                loss += trainPosition(params.data(), nullptr, data[i],
+                                      cfg.lambda);
+            }
+            losses[t] = loss;
+        });
+        double loss = 0;
+        for (double l : losses) {
+            loss += l;
+        }
+        return end > begin ? loss / (end - begin) : 0.0;
+    }
+
+    // Stores the number of completed epochs, which is where a resumed run
+    // continues from.
+    bool saveCheckpoint(int completedEpochs) const {
+        std::ofstream out(cfg.checkpoint, std::ios::binary);
+        const uint32_t header[3] = {0x54324B43, HL_SIZE,
+                                    (uint32_t)completedEpochs};
+        out.write((const char *)header, sizeof(header));
+        out.write((const char *)&step, sizeof(step));
+        for (const auto *buffer : {&params, &m, &v}) {
+            out.write((const char *)buffer->data(),
+                      buffer->size() * sizeof(float));
+        }
+        return out.good();
+    }
+
+    bool loadCheckpoint() {
+        std::ifstream in(cfg.checkpoint, std::ios::binary);
+        uint32_t header[3];
+        if (!in.read((char *)header, sizeof(header)) ||
+            header[0] != 0x54324B43 || header[1] != HL_SIZE) {
+            return false;
+        }
+        epoch = header[2];
+        in.read((char *)&step, sizeof(step));
+        for (auto *buffer : {&params, &m, &v}) {
+            in.read((char *)buffer->data(), buffer->size() * sizeof(float));
+        }
+        return in.good();
+    }
+
+    // The engine computes -(own * w[0..HL) + opp * w[HL..2HL) + bias) with
+    // "own" being the side not to move (see nnue_evaluate), so the stm and
+    // non-stm output halves swap and every output term changes sign.
+    bool writeNetwork() const {
+        FILE *f = fopen(cfg.out.c_str(), "w");
+        if (f == nullptr) {
+            return false;
+        }
+        auto q = [](float x, float s) {
+            return (int)std::clamp(std::lround(x * s), -32767L, 32767L);
+        };
+        fprintf(f, "#pragma once\n\n#include <cstdint>\n\n");
+        fprintf(f, "constexpr int16_t FEATURE_WEIGHTS[%d][%d] = {\n", INPUT_SIZE,
+                HL_SIZE);
+        for (int row = 0; row < INPUT_SIZE; row++) {
+            fprintf(f, "    {");
+            for (int i = 0; i < HL_SIZE; i++) {
+                fprintf(f, " %d%s", q(params[FT_WEIGHTS + row * HL_SIZE + i], QA),
+                        i + 1 < HL_SIZE ? "," : "");
+            }
+            fprintf(f, " },\n");
+        }
+        fprintf(f, "};\nconstexpr int16_t FEATURE_BIAS[%d] = {\n", HL_SIZE);
+        for (int i = 0; i < HL_SIZE; i++) {
+            fprintf(f, "%d, ", q(params[FT_BIAS + i], QA));
+        }
+        fprintf(f, "\n};\n\nalignas(64) constexpr int16_t OUTPUT_WEIGHTS[%d] = {\n",
+                2 * HL_SIZE);
+        for (int i = 0; i < 2 * HL_SIZE; i++) {
+            const int source = OUT_WEIGHTS + (i < HL_SIZE ? HL_SIZE + i : i - HL_SIZE);
+            fprintf(f, "%d%s", q(-params[source], EVAL_SCALE * QB / QA),
+                    i + 1 < 2 * HL_SIZE ? ", " : "");
+        }
+        fprintf(f, "};\n\nconstexpr int16_t OUTPUT_BIAS = %d;\n",
+                q(-params[OUT_BIAS], EVAL_SCALE * QA * QB));
+        fclose(f);
+        return true;
+    }
+};
+
+static std::vector<TrainingPosition> loadData(const TrainConfig &cfg) {
+    std::vector<TrainingPosition> data;
+    std::ifstream in(cfg.data);
+    std::string line;
+    size_t skipped = 0;
+    while (data.size() < cfg.maxPositions && std::getline(in, line)) {
+        TrainingPosition pos;
+        if (parsePosition(line, pos)) {
+            data.push_back(pos);
+        } else if (!line.empty()) {
+            skipped++;
+        }
+    }
+    printf("loaded %zu positions from %s (%zu skipped)\n", data.size(),
+           cfg.data.c_str(), skipped);
+    return data;
+}
+
+int runTrain(int argc, char **argv) {
+    TrainConfig cfg;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string key = argv[i];
+        std::string value = argv[i + 1];
+        if (key == "--data")
+            cfg.data = value;
+        else if (key == "--out")
+            cfg.out = value;
+        else if (key == "--checkpoint")
+            cfg.checkpoint = value;
+        else if (key == "--resume")
+            cfg.resume = value != "0";
+        else if (key == "--epochs")
+            cfg.epochs = std::stoi(value);
+        else if (key == "--batch")
+            cfg.batchSize = std::max(1, std::stoi(value));
+        else if (key == "--threads")
+            cfg.threads = std::max(1, std::stoi(value));
+        else if (key == "--lr")
+            cfg.lr = std::stof(value);
+        else if (key == "--lr-decay")
+            cfg.lrDecay = std::stof(value);
+        else if (key == "--lambda")
+            cfg.lambda = std::stof(value);
+        else if (key == "--validation")
+            cfg.validation = std::stof(value);
+        else if (key == "--max-positions")
+            cfg.maxPositions = std::stoull(value);
+        else {
+            std::cerr << "Unknown option: " << key << "\n";
+            return 1;
+        }
+    }
+    if (cfg.data.empty()) {
+        std::cerr << "usage: chess2000 train --data pos.plain [--out file.hpp] "
+                     "[--epochs N] [--batch N] [--threads N] [--lr X] "
+                     "[--lr-decay X] [--lambda X] [--validation X] "
+                     "[--checkpoint file] [--resume 1] [--max-positions N]\n";
+        return 1;
+    }
+    if (!(cfg.validation >= 0 && cfg.validation < 1)) {
+        std::cerr << "--validation must be at least 0 and below 1\n";
+        return 1;
+    }
+
+    std::vector<TrainingPosition> data = loadData(cfg);
+    if (data.empty()) {
+        return 1;
+    }
+    // Keep the validation slice fixed, before any shuffling.
+    const size_t trainCount = data.size() - (size_t)(data.size() * cfg.validation);
+    if (trainCount == 0) {
+        std::cerr << "No positions left to train on after the validation "
+                     "slice\n";
+        return 1;
+    }
+
+    Trainer trainer(cfg);
+    if (cfg.resume) {
+        if (trainer.loadCheckpoint()) {
+            printf("resumed from %s at epoch %d\n", cfg.checkpoint.c_str(),
+                   trainer.epoch);
+        } else {
+            printf("no usable checkpoint at %s, starting fresh\n",
+                   cfg.checkpoint.c_str());
+        }
+    }
+
+    std::vector<uint32_t> order(trainCount);
+    for (size_t i = 0; i < trainCount; i++) {
+        order[i] = i;
+    }
+    std::mt19937 rng(trainer.epoch + 1);
+
+    for (; trainer.epoch < cfg.epochs; trainer.epoch++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::shuffle(order.begin(), order.end(), rng);
+        double loss = 0;
+        // The last batch takes whatever is left, so every position trains.
+        for (size_t b = 0; b < trainCount; b += cfg.batchSize) {
+            loss += trainer.batch(data, order, b,
+                                  std::min(trainCount, b + cfg.batchSize));
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> duration = end - start;
+        double validation = trainer.validate(data, trainCount, data.size());
+        printf("epoch %d train loss %.6f validation loss %.6f %.0f pos/s\n",
+               trainer.epoch + 1, loss / trainCount, validation,
+               trainCount / duration.count());
+        fflush(stdout);
+
+        if (!trainer.saveCheckpoint(trainer.epoch + 1) ||
+            !trainer.writeNetwork()) {
+            std::cerr << "Failed to write " << cfg.checkpoint << " or "
+                      << cfg.out << "\n";
+            return 1;
+        }
+    }
+    printf("wrote %s\n", cfg.out.c_str());
+    return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Native trainer for the engine net (768 -> HL_SIZE, SCReLU, 2*HL_SIZE -> 1).
+// Reads "fen | score | wdl" lines (white relative, as written by primer and
+// loaded by data.py) and writes a network_weights header the engine includes.
+int runTrain(int argc, char **argv);
@@ -4,6 +4,7 @@
 #include "move.hpp"
 #include "eval.hpp"
 #include "movegen.hpp"
+#include "perft.hpp"
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -14,7 +15,7 @@ bool white = false;
 bool hasBeenActivated = false;
 int historyTable[2][64][64] = {};
 int captureHistoryTable[2][64][64] = {};
-std::vector<uint64_t> prevHash = {};
+std::vector<uint64_t> gameHistory = {};
 int mg_phase = 0;
 int eg_phase = 0;
 
@@ -36,7 +37,8 @@ void proccessCommand(std::string str, std::unique_ptr<Board> &brd,
     if (tokens[0] == "quit") {
         exit(0);
     } else if (tokens[0] == "position") {
-        prevHash.clear();
+        gameHistory.clear();
+        irreversibleCount = 0;
         if (tokens[1] == "startpos") {
             brd.reset(new Board(loadFenBoard(
                 "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")));
@@ -51,8 +53,8 @@ void proccessCommand(std::string str, std::unique_ptr<Board> &brd,
                 moveIndex = 3;
             }
 
+            ep = -1;
             if (moveIndex < tokens.size()) {
-                int ep = 0;
                 for (size_t i = moveIndex; i < tokens.size(); i++) {
                     MoveCallbacks move;
                     if (white) {
@@ -72,7 +74,7 @@ void proccessCommand(std::string str, std::unique_ptr<Board> &brd,
                         irreversibleCount++;
                     }
                     ep = move.ep;
-                    prevHash.push_back(create_hash(*brd, state->IsWhite));
+                    gameHistory.push_back(create_hash(*brd, state->IsWhite));
                 }
             }
         } else if (tokens[1] == "fen") {
@@ -91,6 +93,7 @@ void proccessCommand(std::string str, std::unique_ptr<Board> &brd,
             }
             brd.reset(new Board(loadFenBoard(fen.c_str())));
             state.reset(new BoardState(parseBoardState(fen.c_str())));
+            ep = parseEnPassantSquare(fen.c_str());
             // printBoard(*brd);
             white = state->IsWhite;
 
@@ -115,12 +118,28 @@ void proccessCommand(std::string str, std::unique_ptr<Board> &brd,
                         irreversibleCount++;
                     }
                     ep = move.ep;
-                    prevHash.push_back(create_hash(*brd, state->IsWhite));
+                    gameHistory.push_back(create_hash(*brd, state->IsWhite));
                 }
             }
             // printBoard(*brd);
             // printBitboard((*brd).Occ);
         }
+    } else if (tokens[0] == "perft" || tokens[0] == "divide") {
+        // perft|divide <depth> [threads N] [hash MB]
+        int depth = tokens.size() > 1 ? std::stoi(tokens[1]) : 1;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        int hashMB = 64;
+        for (size_t i = 2; i + 1 < tokens.size(); i++) {
+            if (tokens[i] == "threads")
+                threads = std::max(1, std::stoi(tokens[i + 1]));
+            if (tokens[i] == "hash")
+                hashMB = std::stoi(tokens[i + 1]);
+        }
+        perftDivide(*brd, *state, ep, depth, tokens[0] == "divide", threads,
+                    hashMB);
+    } else if (tokens[0] == "ucinewgame") {
+        clearHeuristics();
+        TT.clear();
     } else if (tokens[0] == "isready") {
         std::cout << "readyok" << std::endl;
     } else if (tokens[0] == "uci") {
@@ -162,16 +181,17 @@ void proccessCommand(std::string str, std::unique_ptr<Board> &brd,
         bool whiteRight = state->WRC;
         bool blackLeft = state->BLC;
         bool blackRight = state->BRC;
-        SearchStats stats{0,0,true};
+        SearchStats stats{0, 0, true, 0};
 
-        Callback ml =
+        EncodedMove move =
             iterative_deepening(*brd, ep, whiteTurn, enPassant, whiteLeft,
                                 whiteRight, blackLeft, blackRight, think,irreversibleCount,stats,99);
 
-        std::cout << "bestmove " << convertMoveToUCI(*brd, ml.from, ml.to)
+        std::cout << "bestmove " << convertMoveToUCI(*brd, moveFrom(move),
+                                                         moveTo(move))
                   << std::endl;
 
-        MoveResult moveRes = ml.makeMove(*brd, ml.from, ml.to);
+        MoveResult moveRes = makeMove(*brd, *state, move);
         brd.reset(new Board(moveRes.board));
         state.reset(new BoardState(moveRes.state));
         irreversibleCount = 0;
@@ -196,13 +216,60 @@ void runBench(){
     bool whiteRight = state->WRC;
     bool blackLeft = state->BLC;
     bool blackRight = state->BRC;
-    SearchStats stats{0,0,false};
+    SearchStats stats{0, 0, false, 0};
 
-    Callback ml = iterative_deepening(*brd, -1, 1, 0, 1,
+    iterative_deepening(*brd, -1, 1, 0, 1,
                                 1, 1, 1, 5.0,0,stats, 12);
     printf("%ld nodes %ld nps\n", stats.nodes, stats.nps);
 }
 
+// Plays `plies` moves from the start position, searching each to depth 10
+// with the move ordering tables cleared before every move, then searches
+// the same positions again with KEEP_HEURISTICS set. Prints the nodes each
+// search took.
+void runGameBench(int plies) {
+    const char *start =
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    uint64_t totals[2] = {};
+    std::vector<EncodedMove> game;
+    const int keepHeuristics = KEEP_HEURISTICS;
+    for (int keep = 0; keep < 2; keep++) {
+        KEEP_HEURISTICS = keep;
+        clearHeuristics();
+        TT.clear();
+        auto brd = std::make_unique<Board>(loadFenBoard(start));
+        auto state = std::make_unique<BoardState>(parseBoardState(start));
+        int ep = -1;
+        printf("%s:", keep ? "kept" : "cleared");
+        for (int ply = 0; ply < plies; ply++) {
+            SearchStats stats{0, 0, false, 0};
+            EncodedMove move = iterative_deepening(
+                *brd, ep, state->IsWhite, state->EP, state->WLC, state->WRC,
+                state->BLC, state->BRC, 1000.0, 0, stats, 10);
+            printf(" %lu", (unsigned long)stats.totalNodes);
+            totals[keep] += stats.totalNodes;
+            if (keep) {
+                move = game[ply];
+            } else {
+                game.push_back(move);
+            }
+            if (move == 0) {
+                break;
+            }
+            ep = moveKind(move) == MoveKind::DoublePush
+                     ? (moveFrom(move) + moveTo(move)) / 2
+                     : -1;
+            MoveResult result = makeMove(*brd, *state, move);
+            brd.reset(new Board(result.board));
+            state.reset(new BoardState(result.state));
+        }
+        printf("\n");
+    }
+    KEEP_HEURISTICS = keepHeuristics;
+    printf("total cleared %lu kept %lu\n", (unsigned long)totals[0],
+           (unsigned long)totals[1]);
+}
+
 void uciRunGame() {
 
     auto brd = std::make_unique<Board>(loadFenBoard(
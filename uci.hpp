@@ -1,6 +1,9 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 extern bool white;
-extern std::vector<uint64_t> prevHash;
+// Keys of the positions reached in the game, the current one last.
+extern std::vector<uint64_t> gameHistory;
 void uciRunGame();
 void runBench();
+void runGameBench(int plies);